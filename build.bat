@@ -1,6 +1,10 @@
 pushd build
 glslc ../code/shader.vert -o vert.spv
+glslc -DNO_VERTEX_COLOR ../code/shader.vert -o vertnocolor.spv
 glslc ../code/shader.frag -o frag.spv
+glslc ../code/quad.vert -o quadvert.spv
 cl -Od -Z7 -nologo -TC -W3 -I%VK_SDK_PATH%/include ../code/main.c -link -LIBPATH:%VK_SDK_PATH%/Lib User32.lib Gdi32.lib vulkan-1.lib
+cl -O2 -Z7 -nologo -TC -W3 ../code/bench.c -Fe:bench.exe
+cl -O2 -Z7 -nologo -TC -W3 ../code/tests.c -Fe:tests.exe
 popd
 echo done
@@ -0,0 +1,9 @@
+#!/bin/sh
+# NOTE(sen) The renderer is win32-only, this builds the platform-independent benchmark and tests
+set -e
+mkdir -p build
+cd build
+cc -O2 -g -std=gnu11 -Wall -Wno-missing-braces -Wno-unused-function -pthread ../code/bench.c -o bench -lm
+cc -O2 -g -std=gnu11 -Wall -Wno-missing-braces -Wno-unused-function -pthread ../code/tests.c -o tests -lm
+cd ..
+echo done
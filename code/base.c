@@ -0,0 +1,43 @@
+#define true 1
+#define false 0
+
+#define TAU32 6.28318530717958647692f
+#define assert(expr) if (!(expr)) { *((int*)0) = 0; }
+#define arrayCount(arr) (sizeof(arr) / sizeof(arr[0]))
+
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef uint16_t u16;
+typedef uint8_t u8;
+typedef int16_t i16;
+typedef int32_t i32;
+typedef int64_t i64;
+typedef size_t usize;
+typedef intptr_t isize;
+typedef int32_t b32;
+typedef float f32;
+typedef double f64;
+
+typedef struct v2 {
+    f32 x;
+    f32 y;
+} v2;
+
+typedef union v3 {
+    struct {
+        f32 x;
+        f32 y;
+        f32 z;
+    };
+    struct {
+        f32 r;
+        f32 g;
+        f32 b;
+    };
+} v3;
+
+v3
+v3new(f32 x, f32 y, f32 z) {
+    v3 result = { .x = x, .y = y, .z = z };
+    return result;
+}
@@ -0,0 +1,594 @@
+// NOTE(sen) Standalone CPU benchmark for the math and geometry hot paths.
+// No window or GPU, geometry is written into plain host memory.
+//
+// bench [-count N] [-repeats N] [-format text|csv|json] [-simd scalar|sse2|avx2] [-threads N] [-filter name]
+//
+// -threads is the total for the parallel benchmarks, defaults to one per processor
+
+#include "stdint.h"
+#include "stddef.h"
+
+#include "stdlib.h"
+#include "string.h"
+#include "stdio.h"
+
+#include "math.h"
+
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include "time.h"
+#endif
+
+#include "base.c"
+#include "math.c"
+#include "jobs.c"
+#include "heap.c"
+#include "geometry.c"
+#include "drawlist.c"
+#include "uniforms.c"
+#include "cull.c"
+
+typedef struct BenchData {
+    usize count;
+    m4* matA;
+    m4* matB;
+    m4* matOut;
+    v3* axes;
+    f32* angles;
+    v3* eyes;
+    f32* aspects;
+    Rect* rects;
+    Rect* rectsOut;
+    GeometryBuffer geometry;
+    QuadInstanceBuffer instances;
+    RectStore store;
+    RectRun* runs;
+    StagedCopy* copies;
+    u8* staging;
+    DrawList drawList;
+    u32* visible;
+    FreeList freeList;
+    u64* allocSizes;
+    u64* allocOffsets;
+    u8* uniforms;
+    DrawConstants* pushConstants;
+    JobQueue jobs;
+    f32 sink;
+} BenchData;
+
+typedef void BenchFn(BenchData* data);
+
+typedef struct Benchmark {
+    char* name;
+    BenchFn* fn;
+} Benchmark;
+
+typedef struct BenchResult {
+    char* name;
+    usize count;
+    u32 repeats;
+    f64 nsPerOpMean;
+    f64 nsPerOpStddev;
+    f64 nsPerOpMin;
+    f64 nsPerOpMax;
+    f64 opsPerSecond;
+} BenchResult;
+
+u64
+getTimeNs() {
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (u64)((f64)counter.QuadPart * 1e9 / (f64)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+#endif
+}
+
+f32
+randomf32(u32* state, f32 min, f32 max) {
+    // NOTE(sen) xorshift32, fixed seed so runs are comparable
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return min + (f32)(x >> 8) / (f32)(1 << 24) * (max - min);
+}
+
+// NOTE(sen) minUniformBufferOffsetAlignment on most discrete cards
+#define BENCH_UNIFORM_ALIGNMENT 256
+
+void
+initBenchData(BenchData* data, usize count) {
+    memset(data, 0, sizeof(BenchData));
+    data->count = count;
+    data->matA = malloc(sizeof(m4) * count);
+    data->matB = malloc(sizeof(m4) * count);
+    data->matOut = malloc(sizeof(m4) * count);
+    data->axes = malloc(sizeof(v3) * count);
+    data->angles = malloc(sizeof(f32) * count);
+    data->eyes = malloc(sizeof(v3) * count);
+    data->aspects = malloc(sizeof(f32) * count);
+    data->rects = malloc(sizeof(Rect) * count);
+    data->rectsOut = malloc(sizeof(Rect) * count);
+    data->geometry.vertexData = malloc(sizeof(Vertex) * 4 * count);
+    data->geometry.index32 = 4 * count > 65536;
+    data->geometry.indexData = malloc((data->geometry.index32 ? sizeof(u32) : sizeof(u16)) * 6 * count);
+    data->geometry.vertexCapacity = (u32)(4 * count);
+    data->geometry.indexCapacity = (u32)(6 * count);
+    data->instances.data = malloc(sizeof(QuadInstance) * count);
+    data->instances.capacity = (u32)count;
+
+    u32 state = 0x12345678;
+    for (usize index = 0; index < count; index++) {
+        f32* a = (f32*)(data->matA + index);
+        f32* b = (f32*)(data->matB + index);
+        for (u32 element = 0; element < 16; element++) {
+            a[element] = randomf32(&state, -1.0f, 1.0f);
+            b[element] = randomf32(&state, -1.0f, 1.0f);
+        }
+        data->axes[index] = v3new(randomf32(&state, -1.0f, 1.0f), randomf32(&state, -1.0f, 1.0f), randomf32(&state, -1.0f, 1.0f));
+        data->angles[index] = randomf32(&state, 0.0f, TAU32);
+        data->eyes[index] = v3new(randomf32(&state, -5.0f, 5.0f), randomf32(&state, -5.0f, 5.0f), randomf32(&state, 0.5f, 5.0f));
+        data->aspects[index] = randomf32(&state, 0.5f, 2.5f);
+
+        Rect rect = { 0 };
+        rect.topleft = v3new(randomf32(&state, -1.0f, 0.0f), randomf32(&state, -1.0f, 0.0f), randomf32(&state, -1.0f, 1.0f));
+        rect.bottomright = v3new(rect.topleft.x + randomf32(&state, 0.0f, 1.0f), rect.topleft.y + randomf32(&state, 0.0f, 1.0f), rect.topleft.z);
+        rect.textopleft.x = 0.0f;
+        rect.textopleft.y = 1.0f;
+        rect.texbottomright.x = 1.0f;
+        rect.texbottomright.y = 0.0f;
+        data->rects[index] = rect;
+    }
+
+    data->visible = malloc(sizeof(u32) * count);
+    data->allocSizes = malloc(sizeof(u64) * count);
+    data->allocOffsets = malloc(sizeof(u64) * count);
+    u64 allocTotal = 0;
+    for (usize index = 0; index < count; index++) {
+        // NOTE(sen) Buffer-sized requests between 256 bytes and 64KB, sizes from vkGet*MemoryRequirements
+        // are multiples of the alignment
+        data->allocSizes[index] = alignUp(256 + (u64)randomf32(&state, 0.0f, 65280.0f), 256);
+        allocTotal += data->allocSizes[index];
+    }
+    initFreeList(&data->freeList, allocTotal);
+    initDrawList(&data->drawList, (u32)count);
+    initRectStore(&data->store, (u32)count, 1);
+    data->runs = malloc(sizeof(RectRun) * count);
+    data->copies = malloc(sizeof(StagedCopy) * count);
+    data->staging = malloc(sizeof(Vertex) * 4 * count);
+    data->uniforms = malloc(BENCH_UNIFORM_ALIGNMENT * count);
+    data->pushConstants = malloc(sizeof(DrawConstants) * count);
+    for (usize index = 0; index < count; index++) {
+        addStoreRect(&data->store, data->rects[index]);
+    }
+}
+
+// NOTE(sen) Results are folded into data->sink so the work can't be optimized out
+
+void
+benchM4mul(BenchData* data) {
+    for (usize index = 0; index < data->count; index++) {
+        data->matOut[index] = m4mul(data->matA[index], data->matB[index]);
+    }
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchM4mulScalar(BenchData* data) {
+    for (usize index = 0; index < data->count; index++) {
+        data->matOut[index] = m4mulScalar(data->matA[index], data->matB[index]);
+    }
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchM4mulBatch(BenchData* data) {
+    m4mulBatch(data->matOut, data->matA, data->matB, data->count);
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchM4rotation(BenchData* data) {
+    for (usize index = 0; index < data->count; index++) {
+        data->matOut[index] = m4rotation(data->axes[index], data->angles[index]);
+    }
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchM4rotationBatch(BenchData* data) {
+    m4rotationBatch(data->matOut, data->axes, data->angles, data->count);
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchM4lookat(BenchData* data) {
+    v3 target = v3new(0.0f, 0.0f, 0.0f);
+    v3 up = v3new(0.0f, 0.0f, 1.0f);
+    for (usize index = 0; index < data->count; index++) {
+        data->matOut[index] = m4lookat(data->eyes[index], target, up);
+    }
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchM4perspective(BenchData* data) {
+    for (usize index = 0; index < data->count; index++) {
+        data->matOut[index] = m4perspective(TAU32 / 8, data->aspects[index], 0.1f, 10.0f);
+    }
+    data->sink += data->matOut[data->count - 1].m0;
+}
+
+void
+benchMoveRect(BenchData* data) {
+    for (usize index = 0; index < data->count; index++) {
+        data->rectsOut[index] = moveRect(data->rects[index], 0.001f, -0.002f, 0.0f);
+    }
+    data->sink += data->rectsOut[data->count - 1].topleft.x;
+}
+
+void
+benchPushRect(BenchData* data) {
+    data->geometry.curVertex = 0;
+    data->geometry.curIndex = 0;
+    for (usize index = 0; index < data->count; index++) {
+        pushRect(&data->geometry, data->rects[index]);
+    }
+    data->sink += data->geometry.vertexData[data->geometry.curVertex - 1].pos.x;
+}
+
+void
+benchPushRects(BenchData* data) {
+    data->geometry.curVertex = 0;
+    data->geometry.curIndex = 0;
+    pushRects(&data->geometry, data->rects, data->count, m4identity());
+    data->sink += data->geometry.vertexData[data->geometry.curVertex - 1].pos.x;
+}
+
+// NOTE(sen) Vertices only, as when drawing with a shared quad index buffer
+void
+benchPushRectsSharedIndices(BenchData* data) {
+    GeometryBuffer geometry = data->geometry;
+    geometry.indexData = 0;
+    geometry.curVertex = 0;
+    geometry.curIndex = 0;
+    pushRects(&geometry, data->rects, data->count, m4identity());
+    data->sink += geometry.vertexData[geometry.curVertex - 1].pos.x;
+}
+
+void
+benchPushRectsParallel(BenchData* data) {
+    data->geometry.curVertex = 0;
+    data->geometry.curIndex = 0;
+    pushRectsParallel(&data->jobs, &data->geometry, data->rects, data->count, m4identity(), false);
+    data->sink += data->geometry.vertexData[data->geometry.curVertex - 1].pos.x;
+}
+
+void
+benchPushRectsParallelDeterministic(BenchData* data) {
+    data->geometry.curVertex = 0;
+    data->geometry.curIndex = 0;
+    pushRectsParallel(&data->jobs, &data->geometry, data->rects, data->count, m4identity(), true);
+    data->sink += data->geometry.vertexData[data->geometry.curVertex - 1].pos.x;
+}
+
+void
+benchPushRectsFormat(BenchData* data, VertexFormat format, b32 streamingStores) {
+    GeometryBuffer geometry = data->geometry;
+    geometry.format = format;
+    geometry.streamingStores = streamingStores;
+    geometry.curVertex = 0;
+    geometry.curIndex = 0;
+    pushRects(&geometry, data->rects, data->count, m4identity());
+    data->sink += (f32)geometry.vertexBytes[geometry.curVertex * getVertexSize(format) - 1];
+}
+
+void
+benchPushRectsHalf(BenchData* data) {
+    benchPushRectsFormat(data, VertexFormat_Half, false);
+}
+
+void
+benchPushRectsHalfNoColor(BenchData* data) {
+    benchPushRectsFormat(data, VertexFormat_HalfNoColor, false);
+}
+
+// NOTE(sen) Only plain host memory here, so this measures the cost of the extra copy.
+// The win is on write-combined mapped memory where partial line writes are slow.
+void
+benchPushRectsStreaming(BenchData* data) {
+    benchPushRectsFormat(data, VertexFormat_F32, true);
+}
+
+void
+benchPushRectsHalfStreaming(BenchData* data) {
+    benchPushRectsFormat(data, VertexFormat_Half, true);
+}
+
+void
+benchPushQuadInstances(BenchData* data) {
+    data->instances.count = 0;
+    pushQuadInstances(&data->instances, data->rects, data->count, 0xFF000000);
+    data->sink += data->instances.data[data->instances.count - 1].topleft.x;
+}
+
+// NOTE(sen) Retained scene where 1 in 100 rects changed since the last flush, ns/op is per
+// rect in the scene so it compares directly with pushRects rebuilding everything
+void
+benchRectStoreFlush(BenchData* data) {
+    for (u32 slot = 0; slot < data->store.slotCount; slot += 100) {
+        setStoreRect(&data->store, slot, data->rects[data->count - 1 - slot]);
+    }
+    flushRectStore(&data->store, 0, &data->geometry, 0, 0);
+    data->sink += data->geometry.vertexData[data->geometry.curVertex - 1].pos.x;
+}
+
+// NOTE(sen) The CPU side of keeping the same scene in device-local memory: flush into the
+// CPU copy, then pack the changed runs into staging. The GPU side (the copy, and the draws
+// reading local memory instead of host memory) only shows up on a discrete card, toggle
+// with G in the renderer.
+void
+benchRectStoreFlushStaged(BenchData* data) {
+    for (u32 slot = 0; slot < data->store.slotCount; slot += 100) {
+        setStoreRect(&data->store, slot, data->rects[data->count - 1 - slot]);
+    }
+    u32 runCount = 0;
+    flushRectStore(&data->store, 0, &data->geometry, data->runs, &runCount);
+    u64 used = stageRectRuns(
+        &data->geometry, data->runs, runCount,
+        data->staging, 0, sizeof(Vertex) * 4 * data->count, false, data->copies
+    );
+    data->sink += (f32)used;
+}
+
+// NOTE(sen) Key building included, it's part of the per-frame cost
+void
+benchSortDrawList(BenchData* data) {
+    m4 view = m4lookat(v3new(0.0f, -1.0f, 1.5f), v3new(0.0f, 0.0f, 0.0f), v3new(0.0f, 0.0f, 1.0f));
+    data->drawList.count = 0;
+    pushRectDrawItems(&data->drawList, data->rects, (u32)data->count, view, 0, 0);
+    sortDrawList(&data->drawList);
+    data->sink += (f32)data->drawList.items[0].index;
+}
+
+// NOTE(sen) Same camera as the renderer, roughly half the random rects end up culled
+void
+benchCullRects(BenchData* data) {
+    m4 view = m4lookat(v3new(0.0f, -1.0f, 1.5f), v3new(0.0f, 0.0f, 0.0f), v3new(0.0f, 0.0f, 1.0f));
+    m4 proj = m4perspective(TAU32 / 8, 16.0f / 9.0f, 0.1f, 10.0f);
+    Frustum frustum = frustumFromMatrix(m4mul(view, proj));
+    u32 visibleCount = cullRects(&frustum, data->rects, (u32)data->count, data->visible, 0);
+    data->sink += (f32)visibleCount;
+}
+
+// NOTE(sen) One op is an alloc and a free. Works in windows of 1024 live allocations, about
+// what one device memory block holds. Odd allocations go first so the list is fragmented
+// while the rest are released and coalesced.
+void
+benchFreeListAllocFree(BenchData* data) {
+    for (usize first = 0; first < data->count; first += 1024) {
+        usize end = first + 1024 < data->count ? first + 1024 : data->count;
+        for (usize index = first; index < end; index++) {
+            b32 found = allocFreeList(&data->freeList, data->allocSizes[index], 256, data->allocOffsets + index);
+            assert(found);
+        }
+        for (usize index = first + 1; index < end; index += 2) {
+            releaseFreeList(&data->freeList, data->allocOffsets[index], data->allocSizes[index]);
+        }
+        for (usize index = first; index < end; index += 2) {
+            releaseFreeList(&data->freeList, data->allocOffsets[index], data->allocSizes[index]);
+        }
+    }
+    data->sink += (f32)data->freeList.count;
+}
+
+// NOTE(sen) The CPU side of giving every draw its own transform, one op is one draw so
+// ops/s / 1000 is draws per ms. Uniforms: the model folded into a whole UniformBufferObject
+// written at the next aligned offset, as allocTransientUniform does. Push constants: the
+// unit quad model and tint appended to a command stream, as vkCmdPushConstants records them.
+// Driver work (binding the set at a new dynamic offset) isn't in here, toggle with P in the
+// renderer's per-draw mode for that.
+void
+benchPerDrawUniforms(BenchData* data) {
+    UniformBufferObject frame;
+    frame.model = data->matA[0];
+    frame.view = data->matB[0];
+    frame.proj = data->matB[1];
+    for (usize index = 0; index < data->count; index++) {
+        UniformBufferObject* uniforms = (UniformBufferObject*)(data->uniforms + index * BENCH_UNIFORM_ALIGNMENT);
+        uniforms->model = m4mul(getUnitQuadModel(data->rects[index]), frame.model);
+        uniforms->view = frame.view;
+        uniforms->proj = frame.proj;
+    }
+    data->sink += ((UniformBufferObject*)(data->uniforms + (data->count - 1) * BENCH_UNIFORM_ALIGNMENT))->model.m12;
+}
+
+void
+benchPerDrawPushConstants(BenchData* data) {
+    DrawConstants defaults = getDefaultDrawConstants();
+    for (usize index = 0; index < data->count; index++) {
+        DrawConstants* constants = data->pushConstants + index;
+        *constants = defaults;
+        constants->model = getUnitQuadModel(data->rects[index]);
+    }
+    data->sink += data->pushConstants[data->count - 1].model.m12;
+}
+
+static Benchmark globalBenchmarks[] = {
+    { "m4mul", benchM4mul },
+    { "m4mulScalar", benchM4mulScalar },
+    { "m4mulBatch", benchM4mulBatch },
+    { "m4rotation", benchM4rotation },
+    { "m4rotationBatch", benchM4rotationBatch },
+    { "m4lookat", benchM4lookat },
+    { "m4perspective", benchM4perspective },
+    { "moveRect", benchMoveRect },
+    { "pushRect", benchPushRect },
+    { "pushRects", benchPushRects },
+    { "pushRectsSharedIndices", benchPushRectsSharedIndices },
+    { "pushRectsParallel", benchPushRectsParallel },
+    { "pushRectsParallelDeterministic", benchPushRectsParallelDeterministic },
+    { "pushRectsHalf", benchPushRectsHalf },
+    { "pushRectsHalfNoColor", benchPushRectsHalfNoColor },
+    { "pushRectsStreaming", benchPushRectsStreaming },
+    { "pushRectsHalfStreaming", benchPushRectsHalfStreaming },
+    { "pushQuadInstances", benchPushQuadInstances },
+    { "rectStoreFlush", benchRectStoreFlush },
+    { "rectStoreFlushStaged", benchRectStoreFlushStaged },
+    { "sortDrawList", benchSortDrawList },
+    { "cullRects", benchCullRects },
+    { "freeListAllocFree", benchFreeListAllocFree },
+    { "perDrawUniforms", benchPerDrawUniforms },
+    { "perDrawPushConstants", benchPerDrawPushConstants },
+};
+
+BenchResult
+runBenchmark(Benchmark* benchmark, BenchData* data, u32 repeats) {
+    BenchResult result = { 0 };
+    result.name = benchmark->name;
+    result.count = data->count;
+    result.repeats = repeats;
+
+    // NOTE(sen) Warm caches and let the clock ramp up before measuring
+    benchmark->fn(data);
+
+    f64 sum = 0.0;
+    f64 sumSquares = 0.0;
+    result.nsPerOpMin = 1e300;
+    for (u32 repeat = 0; repeat < repeats; repeat++) {
+        u64 start = getTimeNs();
+        benchmark->fn(data);
+        u64 end = getTimeNs();
+        f64 nsPerOp = (f64)(end - start) / (f64)data->count;
+        sum += nsPerOp;
+        sumSquares += nsPerOp * nsPerOp;
+        if (nsPerOp < result.nsPerOpMin) {
+            result.nsPerOpMin = nsPerOp;
+        }
+        if (nsPerOp > result.nsPerOpMax) {
+            result.nsPerOpMax = nsPerOp;
+        }
+    }
+
+    result.nsPerOpMean = sum / repeats;
+    f64 variance = sumSquares / repeats - result.nsPerOpMean * result.nsPerOpMean;
+    result.nsPerOpStddev = variance > 0.0 ? sqrt(variance) : 0.0;
+    result.opsPerSecond = result.nsPerOpMean > 0.0 ? 1e9 / result.nsPerOpMean : 0.0;
+    return result;
+}
+
+char*
+simdLevelName(SimdLevel level) {
+    char* result = "scalar";
+    switch (level) {
+    case SimdLevel_SSE2: result = "sse2"; break;
+    case SimdLevel_AVX2: result = "avx2"; break;
+    default: break;
+    }
+    return result;
+}
+
+int
+main(int argc, char** argv) {
+    usize count = 100000;
+    u32 repeats = 20;
+    char* format = "text";
+    char* filter = 0;
+    u32 threads = getProcessorCount();
+
+    for (i32 argIndex = 1; argIndex + 1 < argc; argIndex += 2) {
+        char* arg = argv[argIndex];
+        char* value = argv[argIndex + 1];
+        if (strcmp(arg, "-count") == 0) {
+            count = strtoull(value, 0, 10);
+        } else if (strcmp(arg, "-repeats") == 0) {
+            repeats = (u32)strtoul(value, 0, 10);
+        } else if (strcmp(arg, "-format") == 0) {
+            format = value;
+        } else if (strcmp(arg, "-filter") == 0) {
+            filter = value;
+        } else if (strcmp(arg, "-threads") == 0) {
+            threads = (u32)strtoul(value, 0, 10);
+        } else if (strcmp(arg, "-simd") == 0) {
+            if (strcmp(value, "scalar") == 0) {
+                setSimdLevel(SimdLevel_Scalar);
+            } else if (strcmp(value, "sse2") == 0) {
+                setSimdLevel(SimdLevel_SSE2);
+            } else {
+                setSimdLevel(SimdLevel_AVX2);
+            }
+        } else {
+            fprintf(stderr, "unknown argument %s\n", arg);
+            return 1;
+        }
+    }
+    if (count == 0 || repeats == 0 || threads == 0) {
+        fprintf(stderr, "count, repeats and threads must be positive\n");
+        return 1;
+    }
+
+    BenchData data;
+    initBenchData(&data, count);
+    initJobQueue(&data.jobs, threads - 1);
+
+    BenchResult results[arrayCount(globalBenchmarks)];
+    u32 resultCount = 0;
+    for (u32 index = 0; index < arrayCount(globalBenchmarks); index++) {
+        Benchmark* benchmark = globalBenchmarks + index;
+        if (filter == 0 || strstr(benchmark->name, filter)) {
+            results[resultCount++] = runBenchmark(benchmark, &data, repeats);
+        }
+    }
+
+    char* simd = simdLevelName(getSimdLevel());
+    if (strcmp(format, "csv") == 0) {
+        printf("name,simd,threads,count,repeats,ns_per_op_mean,ns_per_op_stddev,ns_per_op_min,ns_per_op_max,ops_per_second\n");
+        for (u32 index = 0; index < resultCount; index++) {
+            BenchResult* r = results + index;
+            printf(
+                "%s,%s,%u,%zu,%u,%.4f,%.4f,%.4f,%.4f,%.1f\n",
+                r->name, simd, threads, r->count, r->repeats,
+                r->nsPerOpMean, r->nsPerOpStddev, r->nsPerOpMin, r->nsPerOpMax, r->opsPerSecond
+            );
+        }
+    } else if (strcmp(format, "json") == 0) {
+        printf("{\n  \"simd\": \"%s\",\n  \"threads\": %u,\n  \"results\": [\n", simd, threads);
+        for (u32 index = 0; index < resultCount; index++) {
+            BenchResult* r = results + index;
+            printf(
+                "    {\"name\": \"%s\", \"count\": %zu, \"repeats\": %u, "
+                "\"ns_per_op_mean\": %.4f, \"ns_per_op_stddev\": %.4f, "
+                "\"ns_per_op_min\": %.4f, \"ns_per_op_max\": %.4f, \"ops_per_second\": %.1f}%s\n",
+                r->name, r->count, r->repeats,
+                r->nsPerOpMean, r->nsPerOpStddev, r->nsPerOpMin, r->nsPerOpMax, r->opsPerSecond,
+                index + 1 < resultCount ? "," : ""
+            );
+        }
+        printf("  ]\n}\n");
+    } else {
+        printf("simd: %s, count: %zu, repeats: %u, threads: %u\n", simd, count, repeats, threads);
+        printf("%-32s %12s %12s %12s %16s\n", "name", "ns/op", "stddev", "min", "ops/s");
+        for (u32 index = 0; index < resultCount; index++) {
+            BenchResult* r = results + index;
+            printf(
+                "%-32s %12.3f %12.3f %12.3f %16.0f\n",
+                r->name, r->nsPerOpMean, r->nsPerOpStddev, r->nsPerOpMin, r->opsPerSecond
+            );
+        }
+    }
+
+    // NOTE(sen) Keeps the sink alive
+    if (data.sink == 12345.0f) {
+        printf("\n");
+    }
+
+    return 0;
+}
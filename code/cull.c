@@ -0,0 +1,188 @@
+// NOTE(sen) Frustum culling for rects. Planes come straight out of the combined
+// model * view * proj matrix (Gribb/Hartmann) and each rect is tested as an AABB,
+// so a rect is only culled when it is entirely outside one plane. The near plane is
+// the GL one m4perspective produces, slightly looser than Vulkan's clip volume.
+
+typedef struct Frustum {
+    // NOTE(sen) left, right, bottom, top, near, far as (nx, ny, nz, d), inside is >= 0
+    f32 planes[6][4];
+    f32 absNormals[6][2];
+} Frustum;
+
+typedef struct CullStats {
+    u64 tested;
+    u64 culled;
+} CullStats;
+
+Frustum
+frustumFromMatrix(m4 clip) {
+    f32 rows[4][4] = {
+        { clip.m0, clip.m4, clip.m8, clip.m12 },
+        { clip.m1, clip.m5, clip.m9, clip.m13 },
+        { clip.m2, clip.m6, clip.m10, clip.m14 },
+        { clip.m3, clip.m7, clip.m11, clip.m15 },
+    };
+    Frustum result = { 0 };
+    for (u32 axis = 0; axis < 3; axis++) {
+        for (u32 element = 0; element < 4; element++) {
+            result.planes[axis * 2 + 0][element] = rows[3][element] + rows[axis][element];
+            result.planes[axis * 2 + 1][element] = rows[3][element] - rows[axis][element];
+        }
+    }
+    for (u32 plane = 0; plane < 6; plane++) {
+        result.absNormals[plane][0] = fabsf(result.planes[plane][0]);
+        result.absNormals[plane][1] = fabsf(result.planes[plane][1]);
+    }
+    return result;
+}
+
+// NOTE(sen) The SIMD paths do the same operations in the same order so all levels agree
+b32
+rectOutsideFrustum(Frustum* frustum, Rect rect) {
+    f32 cx = (rect.topleft.x + rect.bottomright.x) * 0.5f;
+    f32 cy = (rect.topleft.y + rect.bottomright.y) * 0.5f;
+    f32 ex = fabsf((rect.bottomright.x - rect.topleft.x) * 0.5f);
+    f32 ey = fabsf((rect.bottomright.y - rect.topleft.y) * 0.5f);
+    f32 z = rect.topleft.z;
+    b32 result = false;
+    for (u32 index = 0; index < 6; index++) {
+        f32* plane = frustum->planes[index];
+        f32* absNormal = frustum->absNormals[index];
+        f32 dist = plane[0] * cx + plane[1] * cy + plane[2] * z + plane[3] + absNormal[0] * ex + absNormal[1] * ey;
+        result |= dist < 0.0f;
+    }
+    return result;
+}
+
+#if MATH_SSE2
+
+// NOTE(sen) Both start at rect index so AVX2 can hand its tail over
+u32
+cullRectsSSE2(Frustum* frustum, Rect* rects, u32 index, u32 count, u32* visible, u32 visibleCount) {
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for (; index + 4 <= count; index += 4) {
+        Rect* r = rects + index;
+        __m128 tlx = _mm_setr_ps(r[0].topleft.x, r[1].topleft.x, r[2].topleft.x, r[3].topleft.x);
+        __m128 tly = _mm_setr_ps(r[0].topleft.y, r[1].topleft.y, r[2].topleft.y, r[3].topleft.y);
+        __m128 brx = _mm_setr_ps(r[0].bottomright.x, r[1].bottomright.x, r[2].bottomright.x, r[3].bottomright.x);
+        __m128 bry = _mm_setr_ps(r[0].bottomright.y, r[1].bottomright.y, r[2].bottomright.y, r[3].bottomright.y);
+        __m128 z = _mm_setr_ps(r[0].topleft.z, r[1].topleft.z, r[2].topleft.z, r[3].topleft.z);
+        __m128 cx = _mm_mul_ps(_mm_add_ps(tlx, brx), half);
+        __m128 cy = _mm_mul_ps(_mm_add_ps(tly, bry), half);
+        __m128 ex = _mm_and_ps(_mm_mul_ps(_mm_sub_ps(brx, tlx), half), absMask);
+        __m128 ey = _mm_and_ps(_mm_mul_ps(_mm_sub_ps(bry, tly), half), absMask);
+
+        __m128 outside = _mm_setzero_ps();
+        for (u32 plane = 0; plane < 6; plane++) {
+            f32* p = frustum->planes[plane];
+            f32* a = frustum->absNormals[plane];
+            __m128 dist = _mm_mul_ps(_mm_set1_ps(p[0]), cx);
+            dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(p[1]), cy));
+            dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(p[2]), z));
+            dist = _mm_add_ps(dist, _mm_set1_ps(p[3]));
+            dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(a[0]), ex));
+            dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(a[1]), ey));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+        }
+
+        u32 inside = ~_mm_movemask_ps(outside) & 0xF;
+        for (u32 lane = 0; lane < 4; lane++) {
+            visible[visibleCount] = index + lane;
+            visibleCount += (inside >> lane) & 1;
+        }
+    }
+    for (; index < count; index++) {
+        visible[visibleCount] = index;
+        visibleCount += !rectOutsideFrustum(frustum, rects[index]);
+    }
+    return visibleCount;
+}
+
+MATH_TARGET_AVX2 u32
+cullRectsAVX2(Frustum* frustum, Rect* rects, u32 index, u32 count, u32* visible, u32 visibleCount) {
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    for (; index + 8 <= count; index += 8) {
+        Rect* r = rects + index;
+        __m256 tlx = _mm256_setr_ps(
+            r[0].topleft.x, r[1].topleft.x, r[2].topleft.x, r[3].topleft.x,
+            r[4].topleft.x, r[5].topleft.x, r[6].topleft.x, r[7].topleft.x
+        );
+        __m256 tly = _mm256_setr_ps(
+            r[0].topleft.y, r[1].topleft.y, r[2].topleft.y, r[3].topleft.y,
+            r[4].topleft.y, r[5].topleft.y, r[6].topleft.y, r[7].topleft.y
+        );
+        __m256 brx = _mm256_setr_ps(
+            r[0].bottomright.x, r[1].bottomright.x, r[2].bottomright.x, r[3].bottomright.x,
+            r[4].bottomright.x, r[5].bottomright.x, r[6].bottomright.x, r[7].bottomright.x
+        );
+        __m256 bry = _mm256_setr_ps(
+            r[0].bottomright.y, r[1].bottomright.y, r[2].bottomright.y, r[3].bottomright.y,
+            r[4].bottomright.y, r[5].bottomright.y, r[6].bottomright.y, r[7].bottomright.y
+        );
+        __m256 z = _mm256_setr_ps(
+            r[0].topleft.z, r[1].topleft.z, r[2].topleft.z, r[3].topleft.z,
+            r[4].topleft.z, r[5].topleft.z, r[6].topleft.z, r[7].topleft.z
+        );
+        __m256 cx = _mm256_mul_ps(_mm256_add_ps(tlx, brx), half);
+        __m256 cy = _mm256_mul_ps(_mm256_add_ps(tly, bry), half);
+        __m256 ex = _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(brx, tlx), half), absMask);
+        __m256 ey = _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(bry, tly), half), absMask);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (u32 plane = 0; plane < 6; plane++) {
+            f32* p = frustum->planes[plane];
+            f32* a = frustum->absNormals[plane];
+            __m256 dist = _mm256_mul_ps(_mm256_set1_ps(p[0]), cx);
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(p[1]), cy));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(p[2]), z));
+            dist = _mm256_add_ps(dist, _mm256_set1_ps(p[3]));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(a[0]), ex));
+            dist = _mm256_add_ps(dist, _mm256_mul_ps(_mm256_set1_ps(a[1]), ey));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+
+        u32 inside = ~_mm256_movemask_ps(outside) & 0xFF;
+        for (u32 lane = 0; lane < 8; lane++) {
+            visible[visibleCount] = index + lane;
+            visibleCount += (inside >> lane) & 1;
+        }
+    }
+    return cullRectsSSE2(frustum, rects, index, count, visible, visibleCount);
+}
+
+#endif
+
+// NOTE(sen) Writes indices of rects that may be visible, in order, returns how many.
+// visible needs room for count entries.
+u32
+cullRects(Frustum* frustum, Rect* rects, u32 count, u32* visible, CullStats* stats) {
+    u32 visibleCount = 0;
+#if MATH_SSE2
+    SimdLevel level = getSimdLevel();
+    if (level == SimdLevel_AVX2) {
+        visibleCount = cullRectsAVX2(frustum, rects, 0, count, visible, 0);
+    } else if (level == SimdLevel_SSE2) {
+        visibleCount = cullRectsSSE2(frustum, rects, 0, count, visible, 0);
+    } else
+#endif
+    {
+        for (u32 index = 0; index < count; index++) {
+            visible[visibleCount] = index;
+            visibleCount += !rectOutsideFrustum(frustum, rects[index]);
+        }
+    }
+    if (stats) {
+        stats->tested += count;
+        stats->culled += count - visibleCount;
+    }
+    return visibleCount;
+}
+
+void
+gatherRects(Rect* rects, u32* indices, u32 count, Rect* out) {
+    for (u32 index = 0; index < count; index++) {
+        out[index] = rects[indices[index]];
+    }
+}
@@ -0,0 +1,190 @@
+// NOTE(sen) Draw items ordered by a 64-bit sort key. Opaque items come first, grouped by
+// pipeline then texture and front-to-back inside a group so the depth test rejects hidden
+// fragments early. Blended items come last, back-to-front before anything else since they
+// have to composite in order.
+//
+// Opaque:  [63] 0 | [62:55] pipeline | [54:39] texture | [38:7] depth
+// Blended: [63] 1 | [62:31] ~depth   | [30:23] pipeline | [22:7] texture
+
+typedef enum DrawLayer {
+    DrawLayer_Opaque,
+    DrawLayer_Blended,
+} DrawLayer;
+
+#define DRAW_KEY_MAX_PIPELINES 256
+#define DRAW_KEY_MAX_TEXTURES 65536
+
+typedef struct DrawItem {
+    u64 key;
+    u32 index;
+    u32 pad;
+} DrawItem;
+
+typedef struct DrawList {
+    DrawItem* items;
+    DrawItem* scratch;
+    u32 count;
+    u32 capacity;
+} DrawList;
+
+// NOTE(sen) Consecutive sorted items sharing pipeline and texture, one draw call each
+typedef struct DrawBatch {
+    u32 pipeline;
+    u32 texture;
+    u32 first;
+    u32 count;
+} DrawBatch;
+
+// NOTE(sen) Flips floats so their bits compare as unsigned in the same order as the values
+u32
+sortableDepth(f32 depth) {
+    u32 bits;
+    memcpy(&bits, &depth, sizeof(u32));
+    u32 result = (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+    return result;
+}
+
+// NOTE(sen) depth is distance along the view direction, smaller is nearer
+u64
+makeDrawKey(DrawLayer layer, u32 pipeline, u32 texture, f32 depth) {
+    assert(pipeline < DRAW_KEY_MAX_PIPELINES);
+    assert(texture < DRAW_KEY_MAX_TEXTURES);
+    u64 sortable = sortableDepth(depth);
+    u64 result;
+    if (layer == DrawLayer_Opaque) {
+        result = ((u64)pipeline << 55) | ((u64)texture << 39) | (sortable << 7);
+    } else {
+        result = (1ull << 63) | ((u64)(~sortable & 0xFFFFFFFF) << 31) | ((u64)pipeline << 23) | ((u64)texture << 7);
+    }
+    return result;
+}
+
+u32
+getDrawKeyPipeline(u64 key) {
+    u32 result = (key >> 63) ? (u32)(key >> 23) & 0xFF : (u32)(key >> 55) & 0xFF;
+    return result;
+}
+
+u32
+getDrawKeyTexture(u64 key) {
+    u32 result = (key >> 63) ? (u32)(key >> 7) & 0xFFFF : (u32)(key >> 39) & 0xFFFF;
+    return result;
+}
+
+void
+initDrawList(DrawList* list, u32 capacity) {
+    memset(list, 0, sizeof(DrawList));
+    list->capacity = capacity;
+    list->items = malloc(sizeof(DrawItem) * capacity);
+    list->scratch = malloc(sizeof(DrawItem) * capacity);
+}
+
+void
+destroyDrawList(DrawList* list) {
+    free(list->items);
+    free(list->scratch);
+    memset(list, 0, sizeof(DrawList));
+}
+
+void
+pushDrawItem(DrawList* list, u64 key, u32 index) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->items = realloc(list->items, sizeof(DrawItem) * list->capacity);
+        list->scratch = realloc(list->scratch, sizeof(DrawItem) * list->capacity);
+    }
+    DrawItem* item = list->items + list->count++;
+    item->key = key;
+    item->index = index;
+    item->pad = 0;
+}
+
+// NOTE(sen) LSD radix sort on 8-bit digits. All histograms come from one pass over the keys,
+// digits every key agrees on are skipped (the unused low bits and, usually, pipeline and
+// texture), so most lists take 4-5 scatter passes. Stable, equal keys keep push order.
+void
+sortDrawList(DrawList* list) {
+    u32 counts[8][256];
+    memset(counts, 0, sizeof(counts));
+    for (u32 index = 0; index < list->count; index++) {
+        u64 key = list->items[index].key;
+        for (u32 digit = 0; digit < 8; digit++) {
+            counts[digit][(key >> (digit * 8)) & 0xFF]++;
+        }
+    }
+
+    DrawItem* source = list->items;
+    DrawItem* dest = list->scratch;
+    for (u32 digit = 0; digit < 8; digit++) {
+        u32* digitCounts = counts[digit];
+        u32 shift = digit * 8;
+        if (list->count == 0 || digitCounts[(source[0].key >> shift) & 0xFF] == list->count) {
+            continue;
+        }
+
+        u32 offsets[256];
+        u32 total = 0;
+        for (u32 bucket = 0; bucket < 256; bucket++) {
+            offsets[bucket] = total;
+            total += digitCounts[bucket];
+        }
+        for (u32 index = 0; index < list->count; index++) {
+            DrawItem item = source[index];
+            dest[offsets[(item.key >> shift) & 0xFF]++] = item;
+        }
+
+        DrawItem* temp = source;
+        source = dest;
+        dest = temp;
+    }
+
+    list->items = source;
+    list->scratch = dest;
+}
+
+// NOTE(sen) Call after sortDrawList, returns how many batches were written
+u32
+getDrawBatches(DrawList* list, DrawBatch* batches, u32 maxBatches) {
+    u32 batchCount = 0;
+    for (u32 index = 0; index < list->count; index++) {
+        u64 key = list->items[index].key;
+        u32 pipeline = getDrawKeyPipeline(key);
+        u32 texture = getDrawKeyTexture(key);
+        DrawBatch* last = batchCount > 0 ? batches + batchCount - 1 : 0;
+        if (last && last->pipeline == pipeline && last->texture == texture) {
+            last->count++;
+        } else {
+            assert(batchCount < maxBatches);
+            DrawBatch* batch = batches + batchCount++;
+            batch->pipeline = pipeline;
+            batch->texture = texture;
+            batch->first = index;
+            batch->count = 1;
+        }
+    }
+    return batchCount;
+}
+
+// NOTE(sen) Rects in sorted order, ready to push so geometry order matches the batches
+void
+gatherSortedRects(DrawList* list, Rect* rects, Rect* sorted) {
+    for (u32 index = 0; index < list->count; index++) {
+        sorted[index] = rects[list->items[index].index];
+    }
+}
+
+// NOTE(sen) Opaque keys for rects on one pipeline and texture, depth from the rect's centre
+void
+pushRectDrawItems(DrawList* list, Rect* rects, u32 count, m4 modelView, u32 pipeline, u32 texture) {
+    for (u32 index = 0; index < count; index++) {
+        Rect rect = rects[index];
+        v3 center = v3new(
+            (rect.topleft.x + rect.bottomright.x) * 0.5f,
+            (rect.topleft.y + rect.bottomright.y) * 0.5f,
+            rect.topleft.z
+        );
+        // NOTE(sen) View space looks down -z
+        f32 depth = -m4transformPoint(modelView, center).z;
+        pushDrawItem(list, makeDrawKey(DrawLayer_Opaque, pipeline, texture, depth), index);
+    }
+}
@@ -0,0 +1,900 @@
+typedef struct Vertex {
+    v3 pos;
+    v3 color;
+    v2 texture;
+} Vertex;
+
+// NOTE(sen) Layouts a GeometryBuffer can write. The packed ones store positions as
+// half floats or snorm16 (so within -1..1, scale with the model matrix), UVs as
+// unorm16 (0..1) and color as RGBA8.
+typedef enum VertexFormat {
+    VertexFormat_F32,
+    VertexFormat_Half,
+    VertexFormat_Snorm16,
+    VertexFormat_HalfNoColor,
+} VertexFormat;
+
+// NOTE(sen) Half and Snorm16, pos.w is padding since 3-component 16-bit formats
+// aren't required for vertex input
+typedef struct VertexPacked {
+    u16 pos[4];
+    u16 texture[2];
+    u32 color;
+} VertexPacked;
+
+typedef struct VertexPackedNoColor {
+    u16 pos[4];
+    u16 texture[2];
+} VertexPackedNoColor;
+
+typedef struct Rect {
+    v3 topleft;
+    v3 bottomright;
+    v2 textopleft;
+    v2 texbottomright;
+} Rect;
+
+f32
+clamp01(f32 value) {
+    if (value < 0.0f) {
+        value = 0.0f;
+    } else if (value > 1.0f) {
+        value = 1.0f;
+    }
+    return value;
+}
+
+u16
+unorm16(f32 value) {
+    return (u16)(clamp01(value) * 65535.0f + 0.5f);
+}
+
+// NOTE(sen) Byte order r g b a, matches VK_FORMAT_R8G8B8A8_UNORM
+u32
+packRGBA8(f32 r, f32 g, f32 b, f32 a) {
+    u32 result = (u32)(clamp01(r) * 255.0f + 0.5f) |
+        ((u32)(clamp01(g) * 255.0f + 0.5f) << 8) |
+        ((u32)(clamp01(b) * 255.0f + 0.5f) << 16) |
+        ((u32)(clamp01(a) * 255.0f + 0.5f) << 24);
+    return result;
+}
+
+i16
+snorm16(f32 value) {
+    if (value < -1.0f) {
+        value = -1.0f;
+    } else if (value > 1.0f) {
+        value = 1.0f;
+    }
+    f32 scaled = value * 32767.0f;
+    return (i16)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+// NOTE(sen) Round to nearest even, overflow goes to infinity. NaNs keep the top of their
+// payload and come out quiet, same bytes as F16C.
+u16
+f32ToHalf(f32 value) {
+    union { f32 f; u32 u; } conv;
+    conv.f = value;
+    u32 sign = (conv.u >> 16) & 0x8000;
+    u32 exponent = (conv.u >> 23) & 0xFF;
+    u32 mantissa = conv.u & 0x7FFFFF;
+    u32 result;
+    if (exponent == 0xFF) {
+        result = sign | 0x7C00 | (mantissa ? (0x200 | (mantissa >> 13)) : 0);
+    } else {
+        i32 halfExponent = (i32)exponent - 127 + 15;
+        if (halfExponent >= 31) {
+            result = sign | 0x7C00;
+        } else if (halfExponent <= 0) {
+            if (halfExponent < -10) {
+                result = sign;
+            } else {
+                // NOTE(sen) Subnormal, the implicit bit becomes part of the mantissa
+                mantissa |= 0x800000;
+                u32 shift = (u32)(14 - halfExponent);
+                u32 half = mantissa >> shift;
+                u32 rest = mantissa & ((1u << shift) - 1);
+                u32 halfway = 1u << (shift - 1);
+                if (rest > halfway || (rest == halfway && (half & 1))) {
+                    half++;
+                }
+                result = sign | half;
+            }
+        } else {
+            u32 half = ((u32)halfExponent << 10) | (mantissa >> 13);
+            u32 rest = mantissa & 0x1FFF;
+            if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+                half++;
+            }
+            result = sign | half;
+        }
+    }
+    return (u16)result;
+}
+
+#if MATH_SSE2
+
+// NOTE(sen) Same operations as the scalar helpers, _mm_cvtps_ph rounds to nearest even like f32ToHalf
+MATH_TARGET_AVX2 void
+packVerticesAVX2(void* dest, Vertex* vertices, usize count, VertexFormat format) {
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 xyzMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    u8* out = (u8*)dest;
+    u32 vertexSize = format == VertexFormat_HalfNoColor ? sizeof(VertexPackedNoColor) : sizeof(VertexPacked);
+    for (usize index = 0; index < count; index++) {
+        Vertex* vertex = vertices + index;
+
+        // NOTE(sen) pos.xyz then color.r, which is masked to 0 for pos.w
+        __m128 pos = _mm_and_ps(_mm_loadu_ps(&vertex->pos.x), xyzMask);
+        __m128i posPacked;
+        if (format == VertexFormat_Snorm16) {
+            __m128 scaled = _mm_mul_ps(_mm_min_ps(_mm_max_ps(pos, _mm_set1_ps(-1.0f)), one), _mm_set1_ps(32767.0f));
+            __m128 sign = _mm_and_ps(_mm_cmplt_ps(scaled, zero), _mm_set1_ps(-0.0f));
+            __m128 rounded = _mm_add_ps(scaled, _mm_or_ps(half, sign));
+            __m128i truncated = _mm_cvttps_epi32(rounded);
+            posPacked = _mm_packs_epi32(truncated, truncated);
+        } else {
+            posPacked = _mm_cvtps_ph(pos, _MM_FROUND_TO_NEAREST_INT);
+        }
+
+        __m128 texture = _mm_castsi128_ps(_mm_loadl_epi64((__m128i*)&vertex->texture));
+        texture = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(texture, zero), one), _mm_set1_ps(65535.0f)), half);
+        __m128i texturePacked = _mm_cvttps_epi32(texture);
+        texturePacked = _mm_packus_epi32(texturePacked, texturePacked);
+
+        __m128i packed = _mm_unpacklo_epi64(posPacked, texturePacked);
+        if (format == VertexFormat_HalfNoColor) {
+            _mm_storel_epi64((__m128i*)out, packed);
+            *(i32*)(out + 8) = _mm_cvtsi128_si32(texturePacked);
+        } else {
+            __m128 color = _mm_setr_ps(vertex->color.r, vertex->color.g, vertex->color.b, 1.0f);
+            color = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(color, zero), one), _mm_set1_ps(255.0f)), half);
+            __m128i colorPacked = _mm_cvttps_epi32(color);
+            colorPacked = _mm_packus_epi32(colorPacked, colorPacked);
+            colorPacked = _mm_packus_epi16(colorPacked, colorPacked);
+            packed = _mm_insert_epi32(packed, _mm_cvtsi128_si32(colorPacked), 3);
+            _mm_storeu_si128((__m128i*)out, packed);
+        }
+        out += vertexSize;
+    }
+}
+
+#endif
+
+u32
+getVertexSize(VertexFormat format) {
+    u32 result = 0;
+    switch (format) {
+    case VertexFormat_F32: result = sizeof(Vertex); break;
+    case VertexFormat_Half: case VertexFormat_Snorm16: result = sizeof(VertexPacked); break;
+    case VertexFormat_HalfNoColor: result = sizeof(VertexPackedNoColor); break;
+    }
+    return result;
+}
+
+void
+packVertices(void* dest, Vertex* vertices, usize count, VertexFormat format) {
+#if MATH_SSE2
+    if (format != VertexFormat_F32 && getSimdLevel() == SimdLevel_AVX2) {
+        packVerticesAVX2(dest, vertices, count, format);
+        return;
+    }
+#endif
+    switch (format) {
+    case VertexFormat_F32: {
+        Vertex* out = (Vertex*)dest;
+        for (usize index = 0; index < count; index++) {
+            out[index] = vertices[index];
+        }
+    } break;
+    case VertexFormat_Half: case VertexFormat_Snorm16: {
+        VertexPacked* out = (VertexPacked*)dest;
+        for (usize index = 0; index < count; index++) {
+            Vertex* vertex = vertices + index;
+            VertexPacked packed;
+            if (format == VertexFormat_Half) {
+                packed.pos[0] = f32ToHalf(vertex->pos.x);
+                packed.pos[1] = f32ToHalf(vertex->pos.y);
+                packed.pos[2] = f32ToHalf(vertex->pos.z);
+            } else {
+                packed.pos[0] = (u16)snorm16(vertex->pos.x);
+                packed.pos[1] = (u16)snorm16(vertex->pos.y);
+                packed.pos[2] = (u16)snorm16(vertex->pos.z);
+            }
+            packed.pos[3] = 0;
+            packed.texture[0] = unorm16(vertex->texture.x);
+            packed.texture[1] = unorm16(vertex->texture.y);
+            packed.color = packRGBA8(vertex->color.r, vertex->color.g, vertex->color.b, 1.0f);
+            out[index] = packed;
+        }
+    } break;
+    case VertexFormat_HalfNoColor: {
+        VertexPackedNoColor* out = (VertexPackedNoColor*)dest;
+        for (usize index = 0; index < count; index++) {
+            Vertex* vertex = vertices + index;
+            VertexPackedNoColor packed;
+            packed.pos[0] = f32ToHalf(vertex->pos.x);
+            packed.pos[1] = f32ToHalf(vertex->pos.y);
+            packed.pos[2] = f32ToHalf(vertex->pos.z);
+            packed.pos[3] = 0;
+            packed.texture[0] = unorm16(vertex->texture.x);
+            packed.texture[1] = unorm16(vertex->texture.y);
+            out[index] = packed;
+        }
+    } break;
+    }
+}
+
+// NOTE(sen) Copy for write-combined destinations. The 64-byte aligned middle goes out with
+// non-temporal stores so every line is written whole, the ragged ends use plain stores.
+void
+copyStreaming(void* dest, void* source, usize size) {
+    u8* out = (u8*)dest;
+    u8* in = (u8*)source;
+#if MATH_SSE2
+    if (getSimdLevel() != SimdLevel_Scalar) {
+        usize head = (64 - ((usize)out & 63)) & 63;
+        if (head > size) {
+            head = size;
+        }
+        memcpy(out, in, head);
+        out += head;
+        in += head;
+        size -= head;
+        for (; size >= 64; size -= 64, out += 64, in += 64) {
+            __m128i a = _mm_loadu_si128((__m128i*)(in + 0));
+            __m128i b = _mm_loadu_si128((__m128i*)(in + 16));
+            __m128i c = _mm_loadu_si128((__m128i*)(in + 32));
+            __m128i d = _mm_loadu_si128((__m128i*)(in + 48));
+            _mm_stream_si128((__m128i*)(out + 0), a);
+            _mm_stream_si128((__m128i*)(out + 16), b);
+            _mm_stream_si128((__m128i*)(out + 32), c);
+            _mm_stream_si128((__m128i*)(out + 48), d);
+        }
+        // NOTE(sen) Streaming stores are weakly ordered, fence before anyone else looks
+        _mm_sfence();
+    }
+#endif
+    memcpy(out, in, size);
+}
+
+// NOTE(sen) CPU side of a vertex/index buffer pair, usually pointing into mapped memory.
+// Indices are 16-bit unless the buffer can hold more vertices than that addresses.
+// With no indexData the quads are drawn with a shared quad index buffer instead,
+// curIndex is still advanced so it can be used as the draw's index count.
+// vertexData is only Vertex for VertexFormat_F32, otherwise see getVertexSize.
+// streamingStores makes pushRects assemble vertices locally and copyStreaming them out,
+// for mapped memory that is write-combined.
+typedef struct GeometryBuffer {
+    union {
+        Vertex* vertexData;
+        u8* vertexBytes;
+    };
+    union {
+        u16* indexData;
+        u32* indexData32;
+    };
+    u32 curVertex;
+    u32 curIndex;
+    u32 vertexCapacity;
+    u32 indexCapacity;
+    b32 index32;
+    VertexFormat format;
+    b32 streamingStores;
+} GeometryBuffer;
+
+// NOTE(sen) How many more rects fit
+u32
+getGeometryRectRoom(GeometryBuffer* buffer) {
+    u32 vertexRoom = (buffer->vertexCapacity - buffer->curVertex) / 4;
+    u32 indexRoom = (buffer->indexCapacity - buffer->curIndex) / 6;
+    return vertexRoom < indexRoom ? vertexRoom : indexRoom;
+}
+
+void
+pushQuadIndices(GeometryBuffer* buffer, u32 firstVertex) {
+    u32 quad[] = { 0, 1, 2, 1, 3, 2 };
+    if (buffer->indexData == 0) {
+        // NOTE(sen) Shared quad indices
+    } else if (buffer->index32) {
+        for (u32 index = 0; index < 6; index++) {
+            buffer->indexData32[buffer->curIndex + index] = firstVertex + quad[index];
+        }
+    } else {
+        for (u32 index = 0; index < 6; index++) {
+            buffer->indexData[buffer->curIndex + index] = (u16)(firstVertex + quad[index]);
+        }
+    }
+    buffer->curIndex += 6;
+}
+
+Rect
+moveRect(Rect rect, f32 byx, f32 byy, f32 byz) {
+    Rect result = rect;
+    result.topleft.x += byx;
+    result.topleft.y += byy;
+    result.topleft.z += byz;
+    result.bottomright.x += byx;
+    result.bottomright.y += byy;
+    result.bottomright.z += byz;
+    return result;
+}
+
+// NOTE(sen) Corners in order topleft, topright, bottomleft, bottomright, color is black
+void
+getRectCorners(Rect rect, Vertex* corners) {
+
+    assert(rect.topleft.z == rect.bottomright.z);
+
+    v3 black = { 0 };
+
+    corners[0].pos = rect.topleft;
+    corners[0].color = black;
+    corners[0].texture = rect.textopleft;
+
+    v3 topright = rect.topleft;
+    topright.x = rect.bottomright.x;
+
+    v2 textopright = rect.textopleft;
+    textopright.x = rect.texbottomright.x;
+
+    corners[1].pos = topright;
+    corners[1].color = black;
+    corners[1].texture = textopright;
+
+    v3 bottomleft = rect.bottomright;
+    bottomleft.x = rect.topleft.x;
+
+    v2 texbottomleft = rect.texbottomright;
+    texbottomleft.x = rect.textopleft.x;
+
+    corners[2].pos = bottomleft;
+    corners[2].color = black;
+    corners[2].texture = texbottomleft;
+
+    corners[3].pos = rect.bottomright;
+    corners[3].color = black;
+    corners[3].texture = rect.texbottomright;
+}
+
+void
+pushQuad(GeometryBuffer* buffer, Vertex* corners) {
+    packVertices(buffer->vertexBytes + buffer->curVertex * getVertexSize(buffer->format), corners, 4, buffer->format);
+    pushQuadIndices(buffer, buffer->curVertex);
+    buffer->curVertex += 4;
+}
+
+void
+pushRect(GeometryBuffer* buffer, Rect rect) {
+    assert(getGeometryRectRoom(buffer) >= 1);
+    Vertex corners[4];
+    getRectCorners(rect, corners);
+    pushQuad(buffer, corners);
+}
+
+// NOTE(sen) Same corners as pushRect, with every position run through m4transformPoint
+void
+pushRectTransformed(GeometryBuffer* buffer, Rect rect, m4 transform) {
+    assert(getGeometryRectRoom(buffer) >= 1);
+    Vertex corners[4];
+    getRectCorners(rect, corners);
+    for (u32 index = 0; index < 4; index++) {
+        corners[index].pos = m4transformPoint(transform, corners[index].pos);
+    }
+    pushQuad(buffer, corners);
+}
+
+#if MATH_SSE2
+
+// NOTE(sen) Lanes are the corners in pushRect order: topleft, topright, bottomleft, bottomright
+void
+rectCornersSSE2(Rect* rect, __m128* x, __m128* y, __m128* z, __m128* u, __m128* v) {
+    *x = _mm_setr_ps(rect->topleft.x, rect->bottomright.x, rect->topleft.x, rect->bottomright.x);
+    *y = _mm_setr_ps(rect->topleft.y, rect->topleft.y, rect->bottomright.y, rect->bottomright.y);
+    *z = _mm_setr_ps(rect->topleft.z, rect->topleft.z, rect->bottomright.z, rect->bottomright.z);
+    *u = _mm_setr_ps(rect->textopleft.x, rect->texbottomright.x, rect->textopleft.x, rect->texbottomright.x);
+    *v = _mm_setr_ps(rect->textopleft.y, rect->textopleft.y, rect->texbottomright.y, rect->texbottomright.y);
+}
+
+void
+pushRectVerticesSSE2(Vertex* dest, Rect* rect, f32* transform) {
+    __m128 x, y, z, u, v;
+    rectCornersSSE2(rect, &x, &y, &z, &u, &v);
+
+    // NOTE(sen) Same order of operations as m4transformPoint
+    __m128 px = _mm_mul_ps(_mm_set1_ps(transform[0]), x);
+    px = _mm_add_ps(px, _mm_mul_ps(_mm_set1_ps(transform[4]), y));
+    px = _mm_add_ps(px, _mm_mul_ps(_mm_set1_ps(transform[8]), z));
+    px = _mm_add_ps(px, _mm_set1_ps(transform[12]));
+    __m128 py = _mm_mul_ps(_mm_set1_ps(transform[1]), x);
+    py = _mm_add_ps(py, _mm_mul_ps(_mm_set1_ps(transform[5]), y));
+    py = _mm_add_ps(py, _mm_mul_ps(_mm_set1_ps(transform[9]), z));
+    py = _mm_add_ps(py, _mm_set1_ps(transform[13]));
+    __m128 pz = _mm_mul_ps(_mm_set1_ps(transform[2]), x);
+    pz = _mm_add_ps(pz, _mm_mul_ps(_mm_set1_ps(transform[6]), y));
+    pz = _mm_add_ps(pz, _mm_mul_ps(_mm_set1_ps(transform[10]), z));
+    pz = _mm_add_ps(pz, _mm_set1_ps(transform[14]));
+
+    // NOTE(sen) A vertex is 8 floats: pos.xyz color.r | color.gb texture.uv, color is black
+    __m128 zero = _mm_setzero_ps();
+    __m128 zero2 = zero;
+    _MM_TRANSPOSE4_PS(px, py, pz, zero);
+    __m128 t0 = zero2, t1 = zero2, t2 = u, t3 = v;
+    _MM_TRANSPOSE4_PS(t0, t1, t2, t3);
+
+    f32* out = (f32*)dest;
+    _mm_storeu_ps(out + 0, px);
+    _mm_storeu_ps(out + 4, t0);
+    _mm_storeu_ps(out + 8, py);
+    _mm_storeu_ps(out + 12, t1);
+    _mm_storeu_ps(out + 16, pz);
+    _mm_storeu_ps(out + 20, t2);
+    _mm_storeu_ps(out + 24, zero);
+    _mm_storeu_ps(out + 28, t3);
+}
+
+// NOTE(sen) Two rects in 8 lanes, one whole 32-byte vertex per store
+MATH_TARGET_AVX2 void
+pushRectVertices2AVX2(Vertex* dest, Rect* rects, f32* transform) {
+    __m128 x0, y0, z0, u0, v0;
+    __m128 x1, y1, z1, u1, v1;
+    rectCornersSSE2(rects + 0, &x0, &y0, &z0, &u0, &v0);
+    rectCornersSSE2(rects + 1, &x1, &y1, &z1, &u1, &v1);
+#define COMBINE(lo, hi) _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1)
+    __m256 x = COMBINE(x0, x1);
+    __m256 y = COMBINE(y0, y1);
+    __m256 z = COMBINE(z0, z1);
+    __m256 u = COMBINE(u0, u1);
+    __m256 v = COMBINE(v0, v1);
+#undef COMBINE
+
+    __m256 px = _mm256_mul_ps(_mm256_set1_ps(transform[0]), x);
+    px = _mm256_add_ps(px, _mm256_mul_ps(_mm256_set1_ps(transform[4]), y));
+    px = _mm256_add_ps(px, _mm256_mul_ps(_mm256_set1_ps(transform[8]), z));
+    px = _mm256_add_ps(px, _mm256_set1_ps(transform[12]));
+    __m256 py = _mm256_mul_ps(_mm256_set1_ps(transform[1]), x);
+    py = _mm256_add_ps(py, _mm256_mul_ps(_mm256_set1_ps(transform[5]), y));
+    py = _mm256_add_ps(py, _mm256_mul_ps(_mm256_set1_ps(transform[9]), z));
+    py = _mm256_add_ps(py, _mm256_set1_ps(transform[13]));
+    __m256 pz = _mm256_mul_ps(_mm256_set1_ps(transform[2]), x);
+    pz = _mm256_add_ps(pz, _mm256_mul_ps(_mm256_set1_ps(transform[6]), y));
+    pz = _mm256_add_ps(pz, _mm256_mul_ps(_mm256_set1_ps(transform[10]), z));
+    pz = _mm256_add_ps(pz, _mm256_set1_ps(transform[14]));
+
+    // NOTE(sen) 4x4 transposes within each 128-bit half
+    __m256 zero = _mm256_setzero_ps();
+    __m256 a0 = _mm256_unpacklo_ps(px, py);
+    __m256 a1 = _mm256_unpackhi_ps(px, py);
+    __m256 a2 = _mm256_unpacklo_ps(pz, zero);
+    __m256 a3 = _mm256_unpackhi_ps(pz, zero);
+    __m256 b0 = _mm256_unpacklo_ps(zero, zero);
+    __m256 b1 = _mm256_unpackhi_ps(zero, zero);
+    __m256 b2 = _mm256_unpacklo_ps(u, v);
+    __m256 b3 = _mm256_unpackhi_ps(u, v);
+    __m256 pos[4];
+    __m256 tex[4];
+    pos[0] = _mm256_shuffle_ps(a0, a2, 0x44);
+    pos[1] = _mm256_shuffle_ps(a0, a2, 0xEE);
+    pos[2] = _mm256_shuffle_ps(a1, a3, 0x44);
+    pos[3] = _mm256_shuffle_ps(a1, a3, 0xEE);
+    tex[0] = _mm256_shuffle_ps(b0, b2, 0x44);
+    tex[1] = _mm256_shuffle_ps(b0, b2, 0xEE);
+    tex[2] = _mm256_shuffle_ps(b1, b3, 0x44);
+    tex[3] = _mm256_shuffle_ps(b1, b3, 0xEE);
+
+    f32* out = (f32*)dest;
+    for (u32 corner = 0; corner < 4; corner++) {
+        _mm256_storeu_ps(out + corner * 8, _mm256_permute2f128_ps(pos[corner], tex[corner], 0x20));
+        _mm256_storeu_ps(out + 32 + corner * 8, _mm256_permute2f128_ps(pos[corner], tex[corner], 0x31));
+    }
+}
+
+#endif
+
+// NOTE(sen) Works 4 rects at a time so that the 24 indices are exactly 3 (16-bit)
+// or 6 (32-bit) vector stores
+void
+pushRectsF32(GeometryBuffer* buffer, Rect* rects, usize count, m4 transform) {
+    usize index = 0;
+#if MATH_SSE2
+    SimdLevel level = getSimdLevel();
+    if (level >= SimdLevel_SSE2) {
+        __m128i pattern0 = _mm_setr_epi16(0, 1, 2, 1, 3, 2, 4, 5);
+        __m128i pattern1 = _mm_setr_epi16(6, 5, 7, 6, 8, 9, 10, 9);
+        __m128i pattern2 = _mm_setr_epi16(11, 10, 12, 13, 14, 13, 15, 14);
+        __m128i zero = _mm_setzero_si128();
+        f32* mat = (f32*)&transform;
+        for (; index + 4 <= count; index += 4) {
+            Vertex* vertices = buffer->vertexData + buffer->curVertex;
+            if (level == SimdLevel_AVX2) {
+                pushRectVertices2AVX2(vertices, rects + index, mat);
+                pushRectVertices2AVX2(vertices + 8, rects + index + 2, mat);
+            } else {
+                pushRectVerticesSSE2(vertices, rects + index, mat);
+                pushRectVerticesSSE2(vertices + 4, rects + index + 1, mat);
+                pushRectVerticesSSE2(vertices + 8, rects + index + 2, mat);
+                pushRectVerticesSSE2(vertices + 12, rects + index + 3, mat);
+            }
+
+            if (buffer->indexData == 0) {
+                // NOTE(sen) Shared quad indices
+            } else if (buffer->index32) {
+                __m128i base = _mm_set1_epi32((i32)buffer->curVertex);
+                __m128i* indices = (__m128i*)(buffer->indexData32 + buffer->curIndex);
+                _mm_storeu_si128(indices + 0, _mm_add_epi32(_mm_unpacklo_epi16(pattern0, zero), base));
+                _mm_storeu_si128(indices + 1, _mm_add_epi32(_mm_unpackhi_epi16(pattern0, zero), base));
+                _mm_storeu_si128(indices + 2, _mm_add_epi32(_mm_unpacklo_epi16(pattern1, zero), base));
+                _mm_storeu_si128(indices + 3, _mm_add_epi32(_mm_unpackhi_epi16(pattern1, zero), base));
+                _mm_storeu_si128(indices + 4, _mm_add_epi32(_mm_unpacklo_epi16(pattern2, zero), base));
+                _mm_storeu_si128(indices + 5, _mm_add_epi32(_mm_unpackhi_epi16(pattern2, zero), base));
+            } else {
+                __m128i base = _mm_set1_epi16((i16)buffer->curVertex);
+                __m128i* indices = (__m128i*)(buffer->indexData + buffer->curIndex);
+                _mm_storeu_si128(indices + 0, _mm_add_epi16(pattern0, base));
+                _mm_storeu_si128(indices + 1, _mm_add_epi16(pattern1, base));
+                _mm_storeu_si128(indices + 2, _mm_add_epi16(pattern2, base));
+            }
+
+            buffer->curVertex += 16;
+            buffer->curIndex += 24;
+        }
+    }
+#endif
+    for (; index < count; index++) {
+        pushRectTransformed(buffer, rects[index], transform);
+    }
+}
+
+#define PACK_CHUNK_RECTS 64
+
+// NOTE(sen) Transforms and emits count rects in one pass, output is identical
+// to calling pushRectTransformed on each in turn
+void
+pushRects(GeometryBuffer* buffer, Rect* rects, usize count, m4 transform) {
+    assert(getGeometryRectRoom(buffer) >= count);
+    if (buffer->format == VertexFormat_F32 && !buffer->streamingStores) {
+        pushRectsF32(buffer, rects, count, transform);
+    } else {
+        // NOTE(sen) Full vertices into a small scratch buffer first, then packed, and with
+        // streaming stores packed into a second one that is copied out whole
+        Vertex scratch[PACK_CHUNK_RECTS * 4];
+        Vertex packed[PACK_CHUNK_RECTS * 4];
+        u32 vertexSize = getVertexSize(buffer->format);
+        usize done = 0;
+        while (done < count) {
+            usize chunk = count - done;
+            if (chunk > PACK_CHUNK_RECTS) {
+                chunk = PACK_CHUNK_RECTS;
+            }
+            GeometryBuffer scratchBuffer = { 0 };
+            scratchBuffer.vertexData = scratch;
+            scratchBuffer.vertexCapacity = arrayCount(scratch);
+            scratchBuffer.indexCapacity = arrayCount(scratch) / 4 * 6;
+            pushRectsF32(&scratchBuffer, rects + done, chunk, transform);
+
+            u8* dest = buffer->vertexBytes + buffer->curVertex * vertexSize;
+            if (!buffer->streamingStores) {
+                packVertices(dest, scratch, chunk * 4, buffer->format);
+            } else if (buffer->format == VertexFormat_F32) {
+                copyStreaming(dest, scratch, chunk * 4 * vertexSize);
+            } else {
+                packVertices(packed, scratch, chunk * 4, buffer->format);
+                copyStreaming(dest, packed, chunk * 4 * vertexSize);
+            }
+            for (usize rect = 0; rect < chunk; rect++) {
+                pushQuadIndices(buffer, buffer->curVertex);
+                buffer->curVertex += 4;
+            }
+            done += chunk;
+        }
+    }
+}
+
+// NOTE(sen) One per rect for the instanced path, quad.vert makes the corners.
+// 32 bytes against 4 vertices and 6 indices for pushRect.
+typedef struct QuadInstance {
+    v2 topleft;
+    v2 size;
+    f32 depth;
+    u32 color;
+    u16 texRect[4];
+} QuadInstance;
+
+typedef struct QuadInstanceBuffer {
+    QuadInstance* data;
+    u32 count;
+    u32 capacity;
+} QuadInstanceBuffer;
+
+QuadInstance
+rectToQuadInstance(Rect rect, u32 color) {
+    assert(rect.topleft.z == rect.bottomright.z);
+    QuadInstance result;
+    result.topleft.x = rect.topleft.x;
+    result.topleft.y = rect.topleft.y;
+    result.size.x = rect.bottomright.x - rect.topleft.x;
+    result.size.y = rect.bottomright.y - rect.topleft.y;
+    result.depth = rect.topleft.z;
+    result.color = color;
+    result.texRect[0] = unorm16(rect.textopleft.x);
+    result.texRect[1] = unorm16(rect.textopleft.y);
+    result.texRect[2] = unorm16(rect.texbottomright.x);
+    result.texRect[3] = unorm16(rect.texbottomright.y);
+    return result;
+}
+
+void
+pushQuadInstances(QuadInstanceBuffer* buffer, Rect* rects, usize count, u32 color) {
+    assert(buffer->capacity - buffer->count >= count);
+    QuadInstance* dest = buffer->data + buffer->count;
+    for (usize index = 0; index < count; index++) {
+        dest[index] = rectToQuadInstance(rects[index], color);
+    }
+    buffer->count += (u32)count;
+}
+
+// NOTE(sen) Claims room for count rects and returns the first rect slot (vertex slot * 4,
+// index slot * 6). Safe to call from several threads at once. Only curVertex moves,
+// curIndex has to be caught up afterwards, see pushRectsParallel.
+u32
+claimGeometryRects(GeometryBuffer* buffer, u32 count) {
+    u32 firstVertex = atomicAddU32(&buffer->curVertex, count * 4);
+    assert(firstVertex + count * 4 <= buffer->vertexCapacity);
+    return firstVertex / 4;
+}
+
+// NOTE(sen) pushRects into already claimed slots, leaves the buffer's cursors alone
+void
+writeGeometryRects(GeometryBuffer* buffer, u32 firstRect, Rect* rects, usize count, m4 transform) {
+    GeometryBuffer view = *buffer;
+    view.curVertex = firstRect * 4;
+    view.curIndex = firstRect * 6;
+    pushRects(&view, rects, count, transform);
+}
+
+#define PARALLEL_RECTS_PER_JOB 2048
+
+typedef struct ParallelRects {
+    GeometryBuffer* buffer;
+    Rect* rects;
+    usize count;
+    m4 transform;
+    b32 deterministic;
+    u32 firstRect;
+} ParallelRects;
+
+void
+pushRectsJob(void* data, u32 jobIndex) {
+    ParallelRects* batch = (ParallelRects*)data;
+    usize first = (usize)jobIndex * PARALLEL_RECTS_PER_JOB;
+    usize count = batch->count - first;
+    if (count > PARALLEL_RECTS_PER_JOB) {
+        count = PARALLEL_RECTS_PER_JOB;
+    }
+    u32 firstRect;
+    if (batch->deterministic) {
+        firstRect = batch->firstRect + (u32)first;
+    } else {
+        firstRect = claimGeometryRects(batch->buffer, (u32)count);
+    }
+    writeGeometryRects(batch->buffer, firstRect, batch->rects + first, count, batch->transform);
+}
+
+// NOTE(sen) pushRects spread over the queue's threads. Deterministic output is the same
+// bytes as pushRects. Otherwise each job claims its range when it starts, so where each
+// chunk of rects lands depends on scheduling (the quads are the same either way).
+void
+pushRectsParallel(JobQueue* queue, GeometryBuffer* buffer, Rect* rects, usize count, m4 transform, b32 deterministic) {
+    assert(getGeometryRectRoom(buffer) >= count);
+    assert(buffer->curIndex == buffer->curVertex / 4 * 6);
+
+    // NOTE(sen) Detect here rather than have every worker race to
+    getSimdLevel();
+
+    ParallelRects batch = { 0 };
+    batch.buffer = buffer;
+    batch.rects = rects;
+    batch.count = count;
+    batch.transform = transform;
+    batch.deterministic = deterministic;
+    if (deterministic) {
+        batch.firstRect = claimGeometryRects(buffer, (u32)count);
+    }
+
+    u32 jobCount = (u32)((count + PARALLEL_RECTS_PER_JOB - 1) / PARALLEL_RECTS_PER_JOB);
+    runJobs(queue, pushRectsJob, &batch, jobCount);
+
+    buffer->curIndex = buffer->curVertex / 4 * 6;
+}
+
+// NOTE(sen) Retained rects. Every rect keeps the slot it was added in for its whole life,
+// each image's copy of the geometry only gets the slots changed since that image was last
+// flushed rewritten. Slot n is always vertices [n*4, n*4 + 4), removed slots become
+// degenerate quads until reused.
+
+typedef struct RectStore {
+    Rect* rects;
+    u32 slotCount;
+    u32 capacity;
+    u32* freeSlots;
+    u32 freeCount;
+    // NOTE(sen) False once removed, until the slot is reused
+    b32* live;
+    // NOTE(sen) Bit n set means the slot is already queued for image n
+    u32* dirtyImages;
+    // NOTE(sen) Per image list of changed slots, capacity entries each
+    u32* dirtySlots;
+    u32* dirtyCounts;
+    u32 imageCount;
+} RectStore;
+
+// NOTE(sen) Consecutive slots a flush rewrote
+typedef struct RectRun {
+    u32 first;
+    u32 count;
+} RectRun;
+
+void
+markStoreSlotDirty(RectStore* store, u32 slot) {
+    u32 allImages = store->imageCount == 32 ? 0xFFFFFFFF : (1u << store->imageCount) - 1;
+    u32 pending = allImages & ~store->dirtyImages[slot];
+    store->dirtyImages[slot] |= pending;
+    for (u32 imageIndex = 0; pending; imageIndex++, pending >>= 1) {
+        if (pending & 1) {
+            store->dirtySlots[imageIndex * store->capacity + store->dirtyCounts[imageIndex]++] = slot;
+        }
+    }
+}
+
+// NOTE(sen) New images have nothing in them yet so everything is dirty for all of them
+void
+setRectStoreImageCount(RectStore* store, u32 imageCount) {
+    assert(imageCount > 0 && imageCount <= 32);
+    store->imageCount = imageCount;
+    store->dirtySlots = realloc(store->dirtySlots, sizeof(u32) * store->capacity * imageCount);
+    store->dirtyCounts = realloc(store->dirtyCounts, sizeof(u32) * imageCount);
+    memset(store->dirtyCounts, 0, sizeof(u32) * imageCount);
+    memset(store->dirtyImages, 0, sizeof(u32) * store->capacity);
+    for (u32 slot = 0; slot < store->slotCount; slot++) {
+        markStoreSlotDirty(store, slot);
+    }
+}
+
+void
+initRectStore(RectStore* store, u32 capacity, u32 imageCount) {
+    memset(store, 0, sizeof(RectStore));
+    store->capacity = capacity;
+    store->rects = malloc(sizeof(Rect) * capacity);
+    store->freeSlots = malloc(sizeof(u32) * capacity);
+    store->live = malloc(sizeof(b32) * capacity);
+    store->dirtyImages = malloc(sizeof(u32) * capacity);
+    setRectStoreImageCount(store, imageCount);
+}
+
+void
+destroyRectStore(RectStore* store) {
+    free(store->rects);
+    free(store->freeSlots);
+    free(store->live);
+    free(store->dirtyImages);
+    free(store->dirtySlots);
+    free(store->dirtyCounts);
+    memset(store, 0, sizeof(RectStore));
+}
+
+u32
+addStoreRect(RectStore* store, Rect rect) {
+    u32 slot;
+    if (store->freeCount > 0) {
+        slot = store->freeSlots[--store->freeCount];
+        assert(!store->live[slot]);
+    } else {
+        assert(store->slotCount < store->capacity);
+        slot = store->slotCount++;
+        store->dirtyImages[slot] = 0;
+    }
+    store->live[slot] = true;
+    store->rects[slot] = rect;
+    markStoreSlotDirty(store, slot);
+    return slot;
+}
+
+void
+setStoreRect(RectStore* store, u32 slot, Rect rect) {
+    assert(slot < store->slotCount && store->live[slot]);
+    store->rects[slot] = rect;
+    markStoreSlotDirty(store, slot);
+}
+
+void
+removeStoreRect(RectStore* store, u32 slot) {
+    assert(slot < store->slotCount && store->live[slot]);
+    store->live[slot] = false;
+    Rect degenerate = { 0 };
+    store->rects[slot] = degenerate;
+    store->freeSlots[store->freeCount++] = slot;
+    markStoreSlotDirty(store, slot);
+}
+
+// NOTE(sen) Brings one image's geometry up to date, returns the number of rects rewritten.
+// Runs of consecutive changed slots go out as one range. The buffer's cursors end up
+// covering every slot so it can be drawn as is. When runs isn't null it gets the ranges
+// written (room for capacity of them) so a device-local copy can be patched to match.
+u32
+flushRectStore(RectStore* store, u32 imageIndex, GeometryBuffer* buffer, RectRun* runs, u32* runCount) {
+    assert(imageIndex < store->imageCount);
+    assert(store->capacity <= buffer->vertexCapacity / 4);
+    u32* slots = store->dirtySlots + imageIndex * store->capacity;
+    u32 count = store->dirtyCounts[imageIndex];
+    u32 imageBit = 1u << imageIndex;
+    u32 runsWritten = 0;
+    for (u32 index = 0; index < count;) {
+        u32 first = slots[index];
+        u32 end = first + 1;
+        store->dirtyImages[first] &= ~imageBit;
+        index++;
+        while (index < count && slots[index] == end) {
+            store->dirtyImages[end] &= ~imageBit;
+            end++;
+            index++;
+        }
+        writeGeometryRects(buffer, first, store->rects + first, end - first, m4identity());
+        if (runs) {
+            runs[runsWritten].first = first;
+            runs[runsWritten].count = end - first;
+            runsWritten++;
+        }
+    }
+    if (runs) {
+        *runCount = runsWritten;
+    }
+    store->dirtyCounts[imageIndex] = 0;
+    buffer->curVertex = store->slotCount * 4;
+    buffer->curIndex = store->slotCount * 6;
+    return count;
+}
+
+// NOTE(sen) One buffer to buffer copy, same layout as VkBufferCopy
+typedef struct StagedCopy {
+    u64 srcOffset;
+    u64 dstOffset;
+    u64 size;
+} StagedCopy;
+
+// NOTE(sen) Packs the vertices of each run back to back into staging starting at
+// stagingOffset and writes one copy per run, destination offsets as in the buffer.
+// Returns the bytes used, 0 when they don't fit before stagingEnd.
+u64
+stageRectRuns(
+    GeometryBuffer* buffer, RectRun* runs, u32 runCount,
+    u8* staging, u64 stagingOffset, u64 stagingEnd, b32 streamingStores, StagedCopy* copies
+) {
+    u64 rectSize = getVertexSize(buffer->format) * 4;
+    u64 total = 0;
+    for (u32 index = 0; index < runCount; index++) {
+        total += runs[index].count * rectSize;
+    }
+    if (total == 0 || stagingOffset + total > stagingEnd) {
+        return 0;
+    }
+
+    u64 offset = stagingOffset;
+    for (u32 index = 0; index < runCount; index++) {
+        RectRun run = runs[index];
+        u64 size = run.count * rectSize;
+        u8* source = buffer->vertexBytes + run.first * rectSize;
+        if (streamingStores) {
+            copyStreaming(staging + offset, source, size);
+        } else {
+            memcpy(staging + offset, source, size);
+        }
+        copies[index].srcOffset = offset;
+        copies[index].dstOffset = run.first * rectSize;
+        copies[index].size = size;
+        offset += size;
+    }
+    return total;
+}
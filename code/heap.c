@@ -0,0 +1,237 @@
+// NOTE(sen) Offset allocator over one range, used to carve up device memory blocks.
+// Free ranges are kept sorted by offset so neighbours coalesce when released.
+// Best fit, so small allocations don't chip away at the big ranges.
+
+typedef struct FreeRange {
+    u64 offset;
+    u64 size;
+} FreeRange;
+
+typedef struct FreeList {
+    FreeRange* ranges;
+    u32 count;
+    u32 capacity;
+    u64 size;
+    u64 used;
+} FreeList;
+
+// NOTE(sen) Vulkan alignments are always powers of two
+u64
+alignUp(u64 value, u64 alignment) {
+    assert((alignment & (alignment - 1)) == 0);
+    u64 result = (value + alignment - 1) & ~(alignment - 1);
+    return result;
+}
+
+void
+initFreeList(FreeList* list, u64 size) {
+    memset(list, 0, sizeof(FreeList));
+    list->size = size;
+    list->capacity = 16;
+    list->ranges = malloc(sizeof(FreeRange) * list->capacity);
+    list->ranges[0].offset = 0;
+    list->ranges[0].size = size;
+    list->count = 1;
+}
+
+void
+destroyFreeList(FreeList* list) {
+    free(list->ranges);
+    memset(list, 0, sizeof(FreeList));
+}
+
+void
+insertFreeRange(FreeList* list, u32 index, u64 offset, u64 size) {
+    if (list->count == list->capacity) {
+        list->capacity *= 2;
+        list->ranges = realloc(list->ranges, sizeof(FreeRange) * list->capacity);
+    }
+    memmove(list->ranges + index + 1, list->ranges + index, sizeof(FreeRange) * (list->count - index));
+    list->ranges[index].offset = offset;
+    list->ranges[index].size = size;
+    list->count++;
+}
+
+void
+removeFreeRange(FreeList* list, u32 index) {
+    memmove(list->ranges + index, list->ranges + index + 1, sizeof(FreeRange) * (list->count - index - 1));
+    list->count--;
+}
+
+// NOTE(sen) Returns false when nothing fits
+b32
+allocFreeList(FreeList* list, u64 size, u64 alignment, u64* offset) {
+    assert(size > 0 && alignment > 0);
+    u32 bestIndex = 0;
+    u64 bestWaste = 0;
+    b32 found = false;
+    for (u32 index = 0; index < list->count; index++) {
+        FreeRange* range = list->ranges + index;
+        if (range->size < size) {
+            continue;
+        }
+        u64 aligned = alignUp(range->offset, alignment);
+        if (aligned + size <= range->offset + range->size) {
+            u64 waste = range->size - size;
+            if (!found || waste < bestWaste) {
+                found = true;
+                bestIndex = index;
+                bestWaste = waste;
+                if (waste == 0) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (found) {
+        FreeRange range = list->ranges[bestIndex];
+        u64 aligned = alignUp(range.offset, alignment);
+        u64 rangeEnd = range.offset + range.size;
+        u64 allocEnd = aligned + size;
+        removeFreeRange(list, bestIndex);
+        u32 insertAt = bestIndex;
+        if (aligned > range.offset) {
+            insertFreeRange(list, insertAt++, range.offset, aligned - range.offset);
+        }
+        if (allocEnd < rangeEnd) {
+            insertFreeRange(list, insertAt, allocEnd, rangeEnd - allocEnd);
+        }
+        list->used += size;
+        *offset = aligned;
+    }
+    return found;
+}
+
+void
+releaseFreeList(FreeList* list, u64 offset, u64 size) {
+    assert(offset + size <= list->size);
+
+    // NOTE(sen) First range past the released one
+    u32 low = 0;
+    u32 high = list->count;
+    while (low < high) {
+        u32 mid = (low + high) / 2;
+        if (list->ranges[mid].offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    u32 index = low;
+
+    b32 mergePrev = index > 0 && list->ranges[index - 1].offset + list->ranges[index - 1].size == offset;
+    b32 mergeNext = index < list->count && offset + size == list->ranges[index].offset;
+    assert(index == 0 || list->ranges[index - 1].offset + list->ranges[index - 1].size <= offset);
+    assert(index == list->count || offset + size <= list->ranges[index].offset);
+
+    if (mergePrev && mergeNext) {
+        list->ranges[index - 1].size += size + list->ranges[index].size;
+        removeFreeRange(list, index);
+    } else if (mergePrev) {
+        list->ranges[index - 1].size += size;
+    } else if (mergeNext) {
+        list->ranges[index].offset = offset;
+        list->ranges[index].size += size;
+    } else {
+        insertFreeRange(list, index, offset, size);
+    }
+    list->used -= size;
+}
+
+u64
+getFreeListLargest(FreeList* list) {
+    u64 result = 0;
+    for (u32 index = 0; index < list->count; index++) {
+        if (list->ranges[index].size > result) {
+            result = list->ranges[index].size;
+        }
+    }
+    return result;
+}
+
+// NOTE(sen) Bookkeeping for the blocks of a bigger allocator, the memory itself lives with the
+// caller in a parallel array. Contents only move between blocks of the same group.
+typedef struct MemoryBlock {
+    FreeList freeList;
+    u32 group;
+    b32 live;
+    // NOTE(sen) Allocations compaction can't move, a block holding any stays
+    u32 pinnedCount;
+    b32 evacuating;
+} MemoryBlock;
+
+// NOTE(sen) A range in one of the live blocks of the group, false when none has room. Blocks
+// being emptied by compaction are skipped.
+b32
+allocMemoryBlocks(MemoryBlock* blocks, u32 blockCount, u32 group, u64 size, u64 alignment, u32* blockIndex, u64* offset) {
+    b32 found = false;
+    for (u32 index = 0; index < blockCount && !found; index++) {
+        MemoryBlock* block = blocks + index;
+        if (block->live && block->group == group && !block->evacuating) {
+            found = allocFreeList(&block->freeList, size, alignment, offset);
+            *blockIndex = index;
+        }
+    }
+    return found;
+}
+
+// NOTE(sen) Compaction empties sparsely used blocks by moving their contents into the free
+// space of the others. Blocks above maxSize were made for one allocation and are left alone.
+b32
+canEvacuateMemoryBlock(MemoryBlock* block, u64 maxSize) {
+    FreeList* list = &block->freeList;
+    b32 result = block->live && !block->evacuating && block->pinnedCount == 0
+        && list->size <= maxSize && list->used * 2 < list->size;
+    return result;
+}
+
+// NOTE(sen) Emptiest first, as long as what is in the block fits in the free space left in
+// the blocks of the group that stay. Returns the number of blocks marked evacuating.
+u32
+markMemoryBlocksForCompaction(MemoryBlock* blocks, u32 blockCount, u64 maxSize) {
+    u32 marked = 0;
+    for (;;) {
+        MemoryBlock* emptiest = 0;
+        for (u32 index = 0; index < blockCount; index++) {
+            MemoryBlock* block = blocks + index;
+            if (canEvacuateMemoryBlock(block, maxSize) && (!emptiest || block->freeList.used < emptiest->freeList.used)) {
+                // NOTE(sen) Free space the block's contents could go to, less what blocks
+                // already marked will take
+                i64 room = 0;
+                for (u32 other = 0; other < blockCount; other++) {
+                    MemoryBlock* target = blocks + other;
+                    if (other != index && target->live && target->group == block->group) {
+                        if (target->evacuating) {
+                            room -= target->freeList.used;
+                        } else {
+                            room += target->freeList.size - target->freeList.used;
+                        }
+                    }
+                }
+                // NOTE(sen) Headroom for alignment and free ranges too small to use
+                if ((i64)block->freeList.used * 2 <= room) {
+                    emptiest = block;
+                }
+            }
+        }
+        if (!emptiest) {
+            break;
+        }
+        emptiest->evacuating = true;
+        marked++;
+    }
+    return marked;
+}
+
+// NOTE(sen) Call for every block once the moved allocations are released. True when the
+// block was evacuated and is empty, the caller gives it back.
+b32
+endMemoryBlockEvacuation(MemoryBlock* block) {
+    b32 result = false;
+    if (block->evacuating) {
+        block->evacuating = false;
+        result = block->freeList.used == 0;
+    }
+    return result;
+}
@@ -0,0 +1,155 @@
+// NOTE(sen) Host memory allocator behind the driver's VkAllocationCallbacks, see main.c.
+// Counts what is live and can bump object lifetime allocations out of an arena instead of
+// malloc'ing them. Nothing Vulkan in here so it runs in tests.c.
+
+// NOTE(sen) Frees into an arena are only counted, it rewinds once nothing in it is live
+typedef struct HostArena {
+    u8* base;
+    usize size;
+    usize used;
+    u32 live;
+} HostArena;
+
+typedef struct HostAllocStats {
+    usize bytes;
+    usize peakBytes;
+    u32 live;
+    u64 allocations;
+    u64 arenaAllocations;
+    u64 frees;
+    // NOTE(sen) Memory the driver got elsewhere and only told us about
+    usize internalBytes;
+} HostAllocStats;
+
+// NOTE(sen) Swapchain recreation builds the new objects before the old ones are destroyed, so
+// there are two arenas and each rebuild switches to the other one
+typedef struct HostAllocator {
+    HostAllocStats stats;
+    HostArena arenas[2];
+    u32 currentArena;
+} HostAllocator;
+
+// NOTE(sen) Sits right before every block handed out
+typedef struct HostAllocHeader {
+    void* raw;
+    usize size;
+} HostAllocHeader;
+
+#define HOST_ARENA_SIZE (512 * 1024)
+
+HostArena*
+findHostArena(HostAllocator* allocator, void* memory) {
+    HostArena* result = 0;
+    for (u32 index = 0; index < arrayCount(allocator->arenas); index++) {
+        HostArena* arena = allocator->arenas + index;
+        if ((u8*)memory >= arena->base && (u8*)memory < arena->base + arena->size) {
+            result = arena;
+            break;
+        }
+    }
+    return result;
+}
+
+// NOTE(sen) Alignment is of the returned address, arena bases only have what malloc gives.
+// Only object lifetime allocations go in the arena. Returns null when out of memory.
+void*
+allocHost(HostAllocator* allocator, usize size, usize alignment, b32 objectLifetime) {
+    if (alignment < sizeof(HostAllocHeader)) {
+        alignment = sizeof(HostAllocHeader);
+    }
+
+    u8* result = 0;
+    HostArena* arena = allocator->arenas + allocator->currentArena;
+    if (arena->base && objectLifetime) {
+        usize offset = alignUp((usize)arena->base + arena->used + sizeof(HostAllocHeader), alignment) - (usize)arena->base;
+        if (offset + size <= arena->size) {
+            result = arena->base + offset;
+            ((HostAllocHeader*)result - 1)->raw = 0;
+            arena->used = offset + size;
+            arena->live++;
+            allocator->stats.arenaAllocations++;
+        }
+    }
+    if (!result) {
+        u8* raw = malloc(size + alignment + sizeof(HostAllocHeader));
+        if (!raw) {
+            return 0;
+        }
+        result = (u8*)alignUp((usize)raw + sizeof(HostAllocHeader), alignment);
+        ((HostAllocHeader*)result - 1)->raw = raw;
+    }
+    ((HostAllocHeader*)result - 1)->size = size;
+
+    HostAllocStats* stats = &allocator->stats;
+    stats->bytes += size;
+    stats->live++;
+    stats->allocations++;
+    if (stats->bytes > stats->peakBytes) {
+        stats->peakBytes = stats->bytes;
+    }
+    return result;
+}
+
+void
+freeHost(HostAllocator* allocator, void* memory) {
+    if (!memory) {
+        return;
+    }
+    HostAllocHeader* header = (HostAllocHeader*)memory - 1;
+    allocator->stats.bytes -= header->size;
+    allocator->stats.live--;
+    allocator->stats.frees++;
+    if (header->raw) {
+        free(header->raw);
+    } else {
+        HostArena* arena = findHostArena(allocator, memory);
+        assert(arena && arena->live > 0);
+        arena->live--;
+        if (arena->live == 0) {
+            arena->used = 0;
+        }
+    }
+}
+
+void*
+reallocHost(HostAllocator* allocator, void* original, usize size, usize alignment, b32 objectLifetime) {
+    if (!original) {
+        return allocHost(allocator, size, alignment, objectLifetime);
+    }
+    if (size == 0) {
+        freeHost(allocator, original);
+        return 0;
+    }
+    void* result = allocHost(allocator, size, alignment, objectLifetime);
+    if (result) {
+        usize originalSize = ((HostAllocHeader*)original - 1)->size;
+        memcpy(result, original, originalSize < size ? originalSize : size);
+        freeHost(allocator, original);
+    }
+    return result;
+}
+
+// NOTE(sen) Objects that live for the whole run should be created before this, an arena they
+// sit in never rewinds
+void
+initHostArenas(HostAllocator* allocator, usize arenaSize) {
+    for (u32 index = 0; index < arrayCount(allocator->arenas); index++) {
+        allocator->arenas[index].base = malloc(arenaSize);
+        allocator->arenas[index].size = arenaSize;
+    }
+}
+
+void
+destroyHostArenas(HostAllocator* allocator) {
+    for (u32 index = 0; index < arrayCount(allocator->arenas); index++) {
+        assert(allocator->arenas[index].live == 0);
+        free(allocator->arenas[index].base);
+        memset(allocator->arenas + index, 0, sizeof(HostArena));
+    }
+}
+
+// NOTE(sen) Called before a swapchain rebuild so the new objects don't land between the old ones
+void
+flipHostArena(HostAllocator* allocator) {
+    allocator->currentArena = (allocator->currentArena + 1) % arrayCount(allocator->arenas);
+}
@@ -0,0 +1,179 @@
+// NOTE(sen) Fixed pool of worker threads running batches of indexed jobs.
+// runJobs blocks until the whole batch is done, the calling thread helps.
+
+#if defined(_WIN32)
+#include "intrin.h"
+#else
+#include "pthread.h"
+#include "semaphore.h"
+#include "unistd.h"
+#endif
+
+u32
+atomicAddU32(volatile u32* value, u32 add) {
+#if defined(_MSC_VER)
+    return (u32)_InterlockedExchangeAdd((volatile long*)value, (long)add);
+#else
+    return __atomic_fetch_add(value, add, __ATOMIC_SEQ_CST);
+#endif
+}
+
+u32
+getProcessorCount() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+#endif
+}
+
+typedef void JobFn(void* data, u32 jobIndex);
+
+typedef struct JobQueue {
+    u32 workerCount;
+    JobFn* fn;
+    void* data;
+    u32 jobCount;
+    volatile u32 nextJob;
+    b32 quit;
+#if defined(_WIN32)
+    HANDLE* threads;
+    HANDLE start;
+    HANDLE done;
+#else
+    pthread_t* threads;
+    sem_t start;
+    sem_t done;
+#endif
+} JobQueue;
+
+void
+doJobs(JobQueue* queue) {
+    for (;;) {
+        u32 job = atomicAddU32(&queue->nextJob, 1);
+        if (job >= queue->jobCount) {
+            break;
+        }
+        queue->fn(queue->data, job);
+    }
+}
+
+#if defined(_WIN32)
+DWORD WINAPI
+jobWorker(LPVOID param) {
+    JobQueue* queue = (JobQueue*)param;
+    for (;;) {
+        WaitForSingleObject(queue->start, INFINITE);
+        if (queue->quit) {
+            break;
+        }
+        doJobs(queue);
+        ReleaseSemaphore(queue->done, 1, 0);
+    }
+    return 0;
+}
+#else
+void*
+jobWorker(void* param) {
+    JobQueue* queue = (JobQueue*)param;
+    for (;;) {
+        sem_wait(&queue->start);
+        if (queue->quit) {
+            break;
+        }
+        doJobs(queue);
+        sem_post(&queue->done);
+    }
+    return 0;
+}
+#endif
+
+// NOTE(sen) 0 workers is valid, runJobs then runs everything on the caller
+void
+initJobQueue(JobQueue* queue, u32 workerCount) {
+    memset(queue, 0, sizeof(JobQueue));
+    queue->workerCount = workerCount;
+    if (workerCount == 0) {
+        return;
+    }
+#if defined(_WIN32)
+    queue->start = CreateSemaphoreA(0, 0, workerCount, 0);
+    queue->done = CreateSemaphoreA(0, 0, workerCount, 0);
+    queue->threads = malloc(sizeof(HANDLE) * workerCount);
+    for (u32 index = 0; index < workerCount; index++) {
+        queue->threads[index] = CreateThread(0, 0, jobWorker, queue, 0, 0);
+        assert(queue->threads[index]);
+    }
+#else
+    sem_init(&queue->start, 0, 0);
+    sem_init(&queue->done, 0, 0);
+    queue->threads = malloc(sizeof(pthread_t) * workerCount);
+    for (u32 index = 0; index < workerCount; index++) {
+        i32 result = pthread_create(queue->threads + index, 0, jobWorker, queue);
+        assert(result == 0);
+    }
+#endif
+}
+
+void
+destroyJobQueue(JobQueue* queue) {
+    if (queue->workerCount == 0) {
+        return;
+    }
+    queue->quit = true;
+#if defined(_WIN32)
+    ReleaseSemaphore(queue->start, queue->workerCount, 0);
+    WaitForMultipleObjects(queue->workerCount, queue->threads, TRUE, INFINITE);
+    for (u32 index = 0; index < queue->workerCount; index++) {
+        CloseHandle(queue->threads[index]);
+    }
+    CloseHandle(queue->start);
+    CloseHandle(queue->done);
+#else
+    for (u32 index = 0; index < queue->workerCount; index++) {
+        sem_post(&queue->start);
+    }
+    for (u32 index = 0; index < queue->workerCount; index++) {
+        pthread_join(queue->threads[index], 0);
+    }
+    sem_destroy(&queue->start);
+    sem_destroy(&queue->done);
+#endif
+    free(queue->threads);
+    queue->threads = 0;
+}
+
+// NOTE(sen) Calls fn(data, index) for every index below jobCount, in no particular order
+void
+runJobs(JobQueue* queue, JobFn* fn, void* data, u32 jobCount) {
+    queue->fn = fn;
+    queue->data = data;
+    queue->jobCount = jobCount;
+    queue->nextJob = 0;
+
+    // NOTE(sen) Not worth waking workers that would find nothing left to do
+    u32 wake = jobCount > 1 ? jobCount - 1 : 0;
+    if (wake > queue->workerCount) {
+        wake = queue->workerCount;
+    }
+#if defined(_WIN32)
+    if (wake > 0) {
+        ReleaseSemaphore(queue->start, wake, 0);
+    }
+    doJobs(queue);
+    for (u32 index = 0; index < wake; index++) {
+        WaitForSingleObject(queue->done, INFINITE);
+    }
+#else
+    for (u32 index = 0; index < wake; index++) {
+        sem_post(&queue->start);
+    }
+    doJobs(queue);
+    for (u32 index = 0; index < wake; index++) {
+        sem_wait(&queue->done);
+    }
+#endif
+}
@@ -15,555 +15,1554 @@
 
 #include "msg.c"
 
-#define true 1
-#define false 0
+#include "base.c"
+#include "math.c"
+#include "jobs.c"
+#include "heap.c"
+#include "hostalloc.c"
+#include "geometry.c"
+#include "drawlist.c"
+#include "uniforms.c"
+#include "cull.c"
+#include "transform.c"
 
-#define TAU32 6.28318530717958647692f
-#define assert(expr) if (!(expr)) { *((int*)0) = 0; }
 #define zero(x) ZeroMemory(&x, sizeof(x))
-#define arrayCount(arr) sizeof(arr) / sizeof(arr[0])
-
-typedef uint32_t u32;
-typedef uint64_t u64;
-typedef uint16_t u16;
-typedef int32_t i32;
-typedef size_t usize;
-typedef intptr_t isize;
-typedef int32_t b32;
-typedef float f32;
-
-typedef struct v2 {
-    f32 x;
-    f32 y;
-} v2;
-
-typedef union v3 {
-    struct {
-        f32 x;
-        f32 y;
-        f32 z;
-    };
-    struct {
-        f32 r;
-        f32 g;
-        f32 b;
-    };
-} v3;
-
-typedef struct Vertex {
-    v3 pos;
-    v3 color;
-    v2 texture;
-} Vertex;
-
-typedef struct m4 {
-    f32 m0, m4, m8, m12;
-    f32 m1, m5, m9, m13;
-    f32 m2, m6, m10, m14;
-    f32 m3, m7, m11, m15;
-} m4;
-
-typedef struct Rect {
-    v3 topleft;
-    v3 bottomright;
-    v2 textopleft;
-    v2 texbottomright;
-} Rect;
+
+// NOTE(sen) Everything about the physical device that doesn't change while it runs, queried
+// once at startup so swapchain rebuilds and resource creation never go back to the loader.
+// Format properties and memory type lookups fill in on first use.
+#define DEVICE_CAPS_MAX_FORMATS 16
+#define DEVICE_CAPS_MAX_MEMORY_LOOKUPS 32
+
+typedef struct MemoryTypeLookup {
+    u32 memoryTypeBits;
+    VkMemoryPropertyFlags properties;
+    u32 memoryTypeIndex;
+} MemoryTypeLookup;
+
+typedef struct DeviceCaps {
+    VkPhysicalDevice physicalDevice;
+    VkExtensionProperties* extensions;
+    u32 extensionCount;
+    // NOTE(sen) Set when VK_EXT_memory_budget can be queried, it also needs the instance to
+    // have VK_KHR_get_physical_device_properties2 for the query itself
+    b32 memoryBudget;
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceFeatures features;
+    VkPhysicalDeviceMemoryProperties memProperties;
+    VkQueueFamilyProperties* queueFamilies;
+    u32 queueFamilyCount;
+    VkFormat formats[DEVICE_CAPS_MAX_FORMATS];
+    VkFormatProperties formatProperties[DEVICE_CAPS_MAX_FORMATS];
+    u32 formatCount;
+    MemoryTypeLookup memoryLookups[DEVICE_CAPS_MAX_MEMORY_LOOKUPS];
+    u32 memoryLookupCount;
+} DeviceCaps;
+
+// NOTE(sen) Device memory reserved in big blocks per memory type, resources get aligned
+// sub-ranges of them instead of an allocation each. Host visible blocks are mapped once
+// for their whole life. When bufferImageGranularity is above 1, buffers and images are
+// kept in separate blocks so linear and optimal resources never share a page.
+// The sub-ranges are tracked by the MemoryBlock at the same index, see heap.c.
+typedef struct DeviceMemoryBlock {
+    VkDeviceMemory memory;
+    u32 memoryTypeIndex;
+    b32 linear;
+    u8* mapped;
+} DeviceMemoryBlock;
+
+// NOTE(sen) What allocations are for, memory is accounted per category. Swapchain images
+// belong to the driver, that category is an estimate from their size and format.
+typedef enum MemoryCategory {
+    MemoryCategory_SwapChain,
+    MemoryCategory_Depth,
+    MemoryCategory_Uniforms,
+    MemoryCategory_Geometry,
+    MemoryCategory_Textures,
+    MemoryCategory_Staging,
+    MemoryCategory_Count,
+} MemoryCategory;
+
+typedef struct MemoryCategoryStats {
+    VkDeviceSize bytes;
+    VkDeviceSize peakBytes;
+    u32 allocations;
+} MemoryCategoryStats;
+
+typedef struct DeviceHeap {
+    VkDevice device;
+    DeviceCaps* caps;
+    VkDeviceSize blockSize;
+    MemoryBlock* blocks;
+    DeviceMemoryBlock* deviceBlocks;
+    u32 blockCount;
+    MemoryCategoryStats categories[MemoryCategory_Count];
+    // NOTE(sen) What vkAllocateMemory handed out, per memory heap
+    VkDeviceSize reservedBytes[VK_MAX_MEMORY_HEAPS];
+    u32 reservedBlocks;
+    // NOTE(sen) Buffers moved by compaction, destroyed once the copies are done
+    struct RetiredBuffer* retired;
+    u32 retiredCount;
+    u32 retiredCapacity;
+} DeviceHeap;
+
+typedef struct DeviceAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    u32 blockIndex;
+    MemoryCategory category;
+    b32 linear;
+    // NOTE(sen) Null unless the memory is host visible
+    void* mapped;
+    // NOTE(sen) How the buffer was created, so compaction can make another like it
+    VkDeviceSize bufferSize;
+    VkBufferUsageFlags bufferUsage;
+} DeviceAllocation;
+
+typedef struct RetiredBuffer {
+    VkBuffer buffer;
+    DeviceAllocation memory;
+} RetiredBuffer;
+
+// NOTE(sen) How scattered the free space in the heap's blocks is. Dedicated blocks count too.
+typedef struct HeapFragmentation {
+    VkDeviceSize reservedBytes;
+    VkDeviceSize usedBytes;
+    VkDeviceSize freeBytes;
+    VkDeviceSize largestFreeBytes;
+    u32 blockCount;
+    u32 freeRanges;
+} HeapFragmentation;
+
+// NOTE(sen) Compaction runs on its own when the free space is at least this scattered
+// (1 - largest free range / free bytes) and there is a block worth emptying
+#define HEAP_COMPACTION_THRESHOLD 0.5f
+
+#define DEVICE_HEAP_BLOCK_SIZE (64 * 1024 * 1024)
+
+// NOTE(sen) How often the memory report goes to the debugger, 0 turns it off
+#define MEMORY_REPORT_INTERVAL_MS 60000
+
+// NOTE(sen) HostVisible buffers are written in place and read by the GPU from mapped
+// memory, across the bus on discrete cards. DeviceLocal buffers are written to a CPU copy
+// (geometry points at it) and the changed parts go up through a TransientBuffer, worth it for
+// geometry that mostly stays put.
+typedef enum GeometryPlacement {
+    GeometryPlacement_HostVisible,
+    GeometryPlacement_DeviceLocal,
+} GeometryPlacement;
 
 typedef struct VertexIndexBuffer {
-    Vertex* vertexData;
-    u16* indexData;
-    u32 curVertex;
-    u32 curIndex;
+    GeometryBuffer geometry;
+    GeometryPlacement placement;
     VkBuffer vertexBuffer;
     VkBuffer indexBuffer;
-    VkDeviceMemory vertexMemory;
-    VkDeviceMemory indexMemory;
+    DeviceAllocation vertexMemory;
+    DeviceAllocation indexMemory;
 } VertexIndexBuffer;
 
-typedef struct UniformBufferObject {
-    m4 model;
-    m4 view;
-    m4 proj;
-} UniformBufferObject;
+// NOTE(sen) Every quad's indices are the same 6 offset by 4 vertices per quad, so one
+// immutable device-local buffer built at startup can serve all geometry
+typedef struct QuadIndexBuffer {
+    VkBuffer buffer;
+    DeviceAllocation memory;
+    u32 quadCapacity;
+} QuadIndexBuffer;
+
+// NOTE(sen) As many quads as 16-bit indices can address
+#define QUAD_INDEX_BUFFER_QUADS 16384
+
+// NOTE(sen) Geometry for one swapchain image. A frame that pushes more than fits
+// spills into extra blocks (drawn separately), and the next frame on this image
+// replaces them with a single block big enough, so steady state never allocates.
+// With quadIndices set, blocks hold vertices only and never outgrow that buffer.
+typedef struct GeometryStream {
+    DeviceHeap* heap;
+    QuadIndexBuffer* quadIndices;
+    VertexFormat format;
+    VertexIndexBuffer* blocks;
+    u32 blockCount;
+    u32 usedBlocks;
+} GeometryStream;
+
+#define GEOMETRY_BLOCK_VERTICES 4096
+
+// NOTE(sen) Quad instances for one swapchain image. Unlike GeometryStream this grows
+// in place, instances are drawn in one call so they have to stay contiguous.
+typedef struct QuadInstanceStream {
+    DeviceHeap* heap;
+    VkBuffer buffer;
+    DeviceAllocation memory;
+    QuadInstanceBuffer instances;
+} QuadInstanceStream;
+
+#define QUAD_INSTANCE_STREAM_CAPACITY 1024
+
+// NOTE(sen) Indexed draw commands for one swapchain image, written into mapped memory and
+// submitted a run at a time with vkCmdDrawIndexedIndirect. Commands can't move once a run
+// referencing them is recorded, so this doesn't grow, full means draw directly instead.
+typedef struct IndirectDrawBuffer {
+    VkBuffer buffer;
+    DeviceAllocation memory;
+    VkDrawIndexedIndirectCommand* commands;
+    u32 count;
+    u32 capacity;
+    // NOTE(sen) Start of the run not yet submitted
+    u32 runFirst;
+} IndirectDrawBuffer;
+
+#define INDIRECT_DRAW_CAPACITY 4096
+
+// NOTE(sen) Memory that only has to live for one frame: uniforms, one-off vertices and
+// indices, staging for uploads. One persistently mapped buffer split into a segment per
+// swapchain image, allocating is bumping the cursor. A segment is rewound once the fence
+// for that image's last frame has been waited on, so the GPU is done with all of it.
+typedef struct TransientBuffer {
+    VkBuffer buffer;
+    DeviceAllocation memory;
+    u8* data;
+    VkDeviceSize segmentSize;
+    u32 segmentCount;
+    VkDeviceSize segmentStart;
+    VkDeviceSize cursor;
+    VkDeviceSize segmentEnd;
+    VkDeviceSize uniformAlignment;
+    b32 streamingStores;
+    // NOTE(sen) Without HOST_COHERENT, what a frame wrote is flushed before the submit
+    b32 coherent;
+} TransientBuffer;
+
+// NOTE(sen) Room per frame on top of the retained geometry staging, uniforms and the like
+#define TRANSIENT_SEGMENT_SIZE (256 * 1024)
+
+// NOTE(sen) Slots in the retained RectStore, each image gets a vertex buffer this many rects
+// big that is drawn with the shared quad indices
+#define RETAINED_RECT_CAPACITY 1024
+
+// NOTE(sen) Pipeline ids used in draw keys
+typedef enum DrawPipeline {
+    DrawPipeline_Rect,
+    DrawPipeline_Count,
+} DrawPipeline;
+
+#define MAX_DRAW_BATCHES 64
+
+typedef enum DrawMode {
+    DrawMode_Retained,
+    DrawMode_Streamed,
+    DrawMode_Instanced,
+    // NOTE(sen) A draw per rect, each moving a shared unit quad with its own transform
+    DrawMode_PerDraw,
+    DrawMode_Count,
+} DrawMode;
 
 typedef struct SwapChain {
+    DeviceHeap* heap;
     VkSwapchainKHR swapChain;
     u32 imageCount;
+    VkDeviceSize imageBytes;
     v2 surfaceDim;
     VkCommandBuffer* commandBuffers;
     VkFramebuffer* framebuffers;
     VkPipeline graphicsPipeline;
     VkRenderPass renderPass;
     VkImageView* imageViews;
-    VkBuffer* uniformBuffers;
-    VkDeviceMemory* uniformBuffersMemory;
     VkDescriptorPool descriptorPool;
     VkDescriptorSetLayout* layouts;
     VkDescriptorSet* descriptorSets;
-    VertexIndexBuffer* vertexIndexBuffer;
+    VkImageView textureImageView;
+    VkSampler textureSampler;
+    GeometryStream* geometryStreams;
+    QuadInstanceStream* quadInstanceStreams;
+    VertexIndexBuffer* retainedGeometry;
+    GeometryPlacement retainedPlacement;
+    TransientBuffer transient;
+    IndirectDrawBuffer* indirectDraws;
+    VkPipeline quadPipeline;
     VkImage depthImage;
-    VkDeviceMemory depthImageMemory;
+    DeviceAllocation depthImageMemory;
     VkImageView depthImageView;
 } SwapChain;
 
+// NOTE(sen) Host memory the driver asks for through VkAllocationCallbacks, counted per scope.
+// Every Vulkan object is created and destroyed with the callbacks of one scope.
+typedef enum HostScope {
+    HostScope_Instance,
+    HostScope_Device,
+    HostScope_Pipeline,
+    HostScope_SwapChain,
+    HostScope_Count,
+} HostScope;
+
+typedef struct HostScopeAllocator {
+    HostScope scope;
+    VkAllocationCallbacks callbacks;
+    HostAllocator allocator;
+} HostScopeAllocator;
+
 static b32 globalRunning = true;
 static void* globalMainFibre = 0;
 static void* globalPollEventsFibre = 0;
 
-v3
-v3new(f32 x, f32 y, f32 z) {
-    v3 result = { .x = x, .y = y, .z = z };
+// NOTE(sen) Vulkan is only called from the main thread, so the callbacks don't lock
+static HostScopeAllocator globalHostAllocators[HostScope_Count];
+
+// NOTE(sen) pUserData is the scope's HostAllocator, only object lifetime allocations can
+// go in its arena
+VKAPI_ATTR void* VKAPI_CALL
+hostAllocation(void* userData, usize size, usize alignment, VkSystemAllocationScope allocationScope) {
+    void* result = allocHost(userData, size, alignment, allocationScope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
     return result;
 }
 
-m4
-m4transpose(m4 mat) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
-
-    m4 result = { 0 };
-
-    result.m0 = mat.m0;
-    result.m1 = mat.m4;
-    result.m2 = mat.m8;
-    result.m3 = mat.m12;
-    result.m4 = mat.m1;
-    result.m5 = mat.m5;
-    result.m6 = mat.m9;
-    result.m7 = mat.m13;
-    result.m8 = mat.m2;
-    result.m9 = mat.m6;
-    result.m10 = mat.m10;
-    result.m11 = mat.m14;
-    result.m12 = mat.m3;
-    result.m13 = mat.m7;
-    result.m14 = mat.m11;
-    result.m15 = mat.m15;
+VKAPI_ATTR void VKAPI_CALL
+hostFree(void* userData, void* memory) {
+    freeHost(userData, memory);
+}
 
+VKAPI_ATTR void* VKAPI_CALL
+hostReallocation(void* userData, void* original, usize size, usize alignment, VkSystemAllocationScope allocationScope) {
+    void* result = reallocHost(userData, original, size, alignment, allocationScope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
     return result;
 }
 
-m4
-m4identity() {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+VKAPI_ATTR void VKAPI_CALL
+hostInternalAllocation(void* userData, usize size, VkInternalAllocationType type, VkSystemAllocationScope allocationScope) {
+    HostAllocator* allocator = userData;
+    allocator->stats.internalBytes += size;
+}
 
-    m4 result = { 1.0f, 0.0f, 0.0f, 0.0f,
-                  0.0f, 1.0f, 0.0f, 0.0f,
-                  0.0f, 0.0f, 1.0f, 0.0f,
-                  0.0f, 0.0f, 0.0f, 1.0f };
-    return result;
+VKAPI_ATTR void VKAPI_CALL
+hostInternalFree(void* userData, usize size, VkInternalAllocationType type, VkSystemAllocationScope allocationScope) {
+    HostAllocator* allocator = userData;
+    allocator->stats.internalBytes -= size;
 }
 
-m4
-m4translation(f32 x, f32 y, f32 z) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+void
+initHostAllocator(HostScopeAllocator* allocator, HostScope scope) {
+    ZeroMemory(allocator, sizeof(HostScopeAllocator));
+    allocator->scope = scope;
+    allocator->callbacks.pUserData = &allocator->allocator;
+    allocator->callbacks.pfnAllocation = hostAllocation;
+    allocator->callbacks.pfnReallocation = hostReallocation;
+    allocator->callbacks.pfnFree = hostFree;
+    allocator->callbacks.pfnInternalAllocation = hostInternalAllocation;
+    allocator->callbacks.pfnInternalFree = hostInternalFree;
+}
 
-    m4 result = { 1.0f, 0.0f, 0.0f, x,
-                  0.0f, 1.0f, 0.0f, y,
-                  0.0f, 0.0f, 1.0f, z,
-                  0.0f, 0.0f, 0.0f, 1.0f };
+VkAllocationCallbacks*
+getHostCallbacks(HostScope scope) {
+    VkAllocationCallbacks* result = &globalHostAllocators[scope].callbacks;
     return result;
 }
 
-m4
-m4rotationZ(f32 radians) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+char*
+getHostScopeName(HostScope scope) {
+    char* result = "";
+    switch (scope) {
+    case HostScope_Instance: result = "instance"; break;
+    case HostScope_Device: result = "device"; break;
+    case HostScope_Pipeline: result = "pipeline"; break;
+    case HostScope_SwapChain: result = "swapchain"; break;
+    default: break;
+    }
+    return result;
+}
 
-    m4 result = { 1.0f, 0.0f, 0.0f, 0.0f,
-                  0.0f, 1.0f, 0.0f, 0.0f,
-                  0.0f, 0.0f, 1.0f, 0.0f,
-                  0.0f, 0.0f, 0.0f, 1.0f };
+void
+getHostAllocCounts(u64* allocations, u64* arenaAllocations) {
+    *allocations = 0;
+    *arenaAllocations = 0;
+    for (u32 scope = 0; scope < HostScope_Count; scope++) {
+        *allocations += globalHostAllocators[scope].allocator.stats.allocations;
+        *arenaAllocations += globalHostAllocators[scope].allocator.stats.arenaAllocations;
+    }
+}
 
-    f32 cosres = cosf(radians);
-    f32 sinres = sinf(radians);
+// NOTE(sen) Same shape as formatMemoryReport, returns the length written
+u32
+formatHostAllocReport(char* buffer, u32 size) {
+    f64 kb = 1.0 / 1024.0;
+    u32 length = 0;
+    length += snprintf(
+        buffer + length, size - length, "%-10s %10s %10s %6s %10s %10s %10s\n",
+        "host", "live KB", "peak KB", "count", "allocs", "in arena", "internal"
+    );
+    for (u32 scope = 0; scope < HostScope_Count && length < size; scope++) {
+        HostAllocStats* stats = &globalHostAllocators[scope].allocator.stats;
+        length += snprintf(
+            buffer + length, size - length, "%-10s %10.2f %10.2f %6u %10llu %10llu %10.2f\n",
+            getHostScopeName(scope), (f64)stats->bytes * kb, (f64)stats->peakBytes * kb, stats->live,
+            stats->allocations, stats->arenaAllocations, (f64)stats->internalBytes * kb
+        );
+    }
+    return length < size ? length : size - 1;
+}
 
-    result.m0 = cosres;
-    result.m1 = sinres;
-    result.m4 = -sinres;
-    result.m5 = cosres;
+void
+printMsgName(u32 msg_code) {
+    char* name = findMsgName(msg_code);
+    if (name) {
+        char buffer[64];
+        snprintf(buffer, 64, "%s\n", name);
+        OutputDebugString(buffer);
+    } else {
+        OutputDebugString("MSG UNRECOGNIZED\n");
+    }
+}
 
+LRESULT windowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    switch (msg) {
+    case WM_CLOSE: case WM_DESTROY: case WM_QUIT: {
+        globalRunning = false;
+    } break;
+    case WM_ERASEBKGND: {
+        return 1; // NOTE(sen) Prevents flickering
+    } break;
+    case WM_NCCALCSIZE: {
+        return 0; // NOTE(sen) Removes window decorations
+    } break;
+    }
+    return DefWindowProcW(hWnd, msg, wParam, lParam);
+}
+
+VkShaderModule
+createShaderModule(char* filename, VkDevice device) {
+    FILE* file;
+    fopen_s(&file, filename, "rb");
+    fseek(file, 0, SEEK_END);
+    i32 fileSize = ftell(file);
+    void* contents = malloc(fileSize);
+    fseek(file, 0, SEEK_SET);
+    usize read = fread(contents, fileSize, 1, file);
+    assert(read == 1);
+    fclose(file);
+    VkShaderModuleCreateInfo createInfo;
+    ZeroMemory(&createInfo, sizeof(VkShaderModuleCreateInfo));
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = fileSize;
+    createInfo.pCode = (u32*)(contents);
+    VkShaderModule shaderModule;
+    VkResult result = vkCreateShaderModule(device, &createInfo, getHostCallbacks(HostScope_Pipeline), &shaderModule);
+    assert(result == VK_SUCCESS);
+    return shaderModule;
+}
+
+b32
+hasExtension(VkExtensionProperties* extensions, u32 extensionCount, char* name) {
+    b32 result = false;
+    for (u32 index = 0; index < extensionCount; index++) {
+        if (strcmp(extensions[index].extensionName, name) == 0) {
+            result = true;
+            break;
+        }
+    }
     return result;
 }
 
-m4
-m4rotation(v3 axis, f32 radians) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+// NOTE(sen) properties2 is whether the instance was created with
+// VK_KHR_get_physical_device_properties2. The loader hands out a trampoline for its entry
+// points either way, so the pointer alone doesn't say the extension is there.
+void
+initDeviceCaps(DeviceCaps* caps, VkInstance instance, VkPhysicalDevice physicalDevice, b32 properties2) {
+    ZeroMemory(caps, sizeof(DeviceCaps));
+    caps->physicalDevice = physicalDevice;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, 0, &caps->extensionCount, 0);
+    caps->extensions = malloc(sizeof(VkExtensionProperties) * caps->extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, 0, &caps->extensionCount, caps->extensions);
+    if (properties2) {
+        caps->getMemoryProperties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(
+            instance, "vkGetPhysicalDeviceMemoryProperties2KHR"
+        );
+    }
+    caps->memoryBudget = properties2 && caps->getMemoryProperties2 != 0
+        && hasExtension(caps->extensions, caps->extensionCount, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    vkGetPhysicalDeviceProperties(physicalDevice, &caps->properties);
+    vkGetPhysicalDeviceFeatures(physicalDevice, &caps->features);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &caps->memProperties);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &caps->queueFamilyCount, 0);
+    caps->queueFamilies = malloc(sizeof(VkQueueFamilyProperties) * caps->queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &caps->queueFamilyCount, caps->queueFamilies);
+}
 
-    m4 result = { 0 };
+void
+destroyDeviceCaps(DeviceCaps* caps) {
+    free(caps->extensions);
+    free(caps->queueFamilies);
+    ZeroMemory(caps, sizeof(DeviceCaps));
+}
 
-    f32 x = axis.x, y = axis.y, z = axis.z;
+VkFormatProperties
+getFormatProperties(DeviceCaps* caps, VkFormat format) {
+    for (u32 index = 0; index < caps->formatCount; index++) {
+        if (caps->formats[index] == format) {
+            return caps->formatProperties[index];
+        }
+    }
+    assert(caps->formatCount < DEVICE_CAPS_MAX_FORMATS);
+    u32 index = caps->formatCount++;
+    caps->formats[index] = format;
+    vkGetPhysicalDeviceFormatProperties(caps->physicalDevice, format, caps->formatProperties + index);
+    return caps->formatProperties[index];
+}
 
-    f32 lengthSquared = x * x + y * y + z * z;
+// NOTE(sen) Only a handful of (typeBits, properties) pairs ever come up, a linear scan of
+// the ones seen before beats walking the memory types every time
+u32
+findMemoryTypeIndex(
+    DeviceCaps* caps,
+    u32 memoryTypeBits,
+    VkMemoryPropertyFlags properties
+) {
+    for (u32 index = 0; index < caps->memoryLookupCount; index++) {
+        MemoryTypeLookup* lookup = caps->memoryLookups + index;
+        if (lookup->memoryTypeBits == memoryTypeBits && lookup->properties == properties) {
+            return lookup->memoryTypeIndex;
+        }
+    }
 
-    if ((lengthSquared != 1.0f) && (lengthSquared != 0.0f)) {
-        f32 ilength = 1.0f / sqrtf(lengthSquared);
-        x *= ilength;
-        y *= ilength;
-        z *= ilength;
+    VkPhysicalDeviceMemoryProperties* memProperties = &caps->memProperties;
+    i32 memIndex;
+    {
+        b32 found = false;
+        for (u32 index = 0; index < memProperties->memoryTypeCount; index++) {
+            b32 correctType = memoryTypeBits & (1 << index);
+            b32 correctProperties = (memProperties->memoryTypes[index].propertyFlags & properties) == properties;
+            if (correctType && correctProperties) {
+                found = true;
+                memIndex = index;
+                break;
+            }
+        }
+        assert(found);
     }
 
-    f32 sinres = sinf(radians);
-    f32 cosres = cosf(radians);
-    f32 t = 1.0f - cosres;
+    if (caps->memoryLookupCount < DEVICE_CAPS_MAX_MEMORY_LOOKUPS) {
+        MemoryTypeLookup* lookup = caps->memoryLookups + caps->memoryLookupCount++;
+        lookup->memoryTypeBits = memoryTypeBits;
+        lookup->properties = properties;
+        lookup->memoryTypeIndex = memIndex;
+    }
+    return memIndex;
+}
 
-    result.m0 = x * x * t + cosres;
-    result.m1 = y * x * t + z * sinres;
-    result.m2 = z * x * t - y * sinres;
-    result.m3 = 0.0f;
+void
+initDeviceHeap(DeviceHeap* heap, VkDevice device, DeviceCaps* caps) {
+    ZeroMemory(heap, sizeof(DeviceHeap));
+    heap->device = device;
+    heap->caps = caps;
+    heap->blockSize = DEVICE_HEAP_BLOCK_SIZE;
+}
 
-    result.m4 = x * y * t - z * sinres;
-    result.m5 = y * y * t + cosres;
-    result.m6 = z * y * t + x * sinres;
-    result.m7 = 0.0f;
+u32
+getMemoryHeapIndex(DeviceHeap* heap, u32 memoryTypeIndex) {
+    u32 result = heap->caps->memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    return result;
+}
 
-    result.m8 = x * z * t + y * sinres;
-    result.m9 = y * z * t - x * sinres;
-    result.m10 = z * z * t + cosres;
-    result.m11 = 0.0f;
+void
+destroyDeviceMemoryBlock(DeviceHeap* heap, u32 blockIndex) {
+    MemoryBlock* block = heap->blocks + blockIndex;
+    DeviceMemoryBlock* deviceBlock = heap->deviceBlocks + blockIndex;
+    heap->reservedBytes[getMemoryHeapIndex(heap, deviceBlock->memoryTypeIndex)] -= block->freeList.size;
+    heap->reservedBlocks--;
+    if (deviceBlock->mapped) {
+        vkUnmapMemory(heap->device, deviceBlock->memory);
+    }
+    vkFreeMemory(heap->device, deviceBlock->memory, getHostCallbacks(HostScope_Device));
+    destroyFreeList(&block->freeList);
+    ZeroMemory(block, sizeof(MemoryBlock));
+    ZeroMemory(deviceBlock, sizeof(DeviceMemoryBlock));
+}
 
-    result.m12 = 0.0f;
-    result.m13 = 0.0f;
-    result.m14 = 0.0f;
-    result.m15 = 1.0f;
+// NOTE(sen) Everything allocated from the heap has to be freed before this
+void
+destroyDeviceHeap(DeviceHeap* heap) {
+    for (u32 index = 0; index < heap->blockCount; index++) {
+        if (heap->blocks[index].live) {
+            assert(heap->blocks[index].freeList.used == 0);
+            destroyDeviceMemoryBlock(heap, index);
+        }
+    }
+    assert(heap->retiredCount == 0);
+    free(heap->blocks);
+    free(heap->deviceBlocks);
+    free(heap->retired);
+    heap->blocks = 0;
+    heap->deviceBlocks = 0;
+    heap->blockCount = 0;
+    heap->retired = 0;
+}
 
+// NOTE(sen) Blocks only share contents within a memory type, and within a kind when
+// buffers and images are kept apart
+u32
+getDeviceBlockGroup(DeviceHeap* heap, u32 memoryTypeIndex, b32 linear) {
+    b32 separateKinds = heap->caps->properties.limits.bufferImageGranularity > 1;
+    u32 result = memoryTypeIndex * 2 + (separateKinds && linear ? 1 : 0);
     return result;
 }
 
-m4
-m4scale(f32 x, f32 y, f32 z) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+// NOTE(sen) A block for one memory type, big enough for at least minSize. Reuses the slot
+// of a freed block so block indices held by allocations stay valid.
+u32
+createDeviceMemoryBlock(DeviceHeap* heap, u32 memoryTypeIndex, b32 linear, VkDeviceSize minSize) {
+    u32 blockIndex = heap->blockCount;
+    for (u32 index = 0; index < heap->blockCount; index++) {
+        if (!heap->blocks[index].live) {
+            blockIndex = index;
+            break;
+        }
+    }
+    if (blockIndex == heap->blockCount) {
+        heap->blocks = realloc(heap->blocks, sizeof(MemoryBlock) * (heap->blockCount + 1));
+        heap->deviceBlocks = realloc(heap->deviceBlocks, sizeof(DeviceMemoryBlock) * (heap->blockCount + 1));
+        heap->blockCount++;
+    }
+    MemoryBlock* block = heap->blocks + blockIndex;
+    DeviceMemoryBlock* deviceBlock = heap->deviceBlocks + blockIndex;
+    ZeroMemory(block, sizeof(MemoryBlock));
+    ZeroMemory(deviceBlock, sizeof(DeviceMemoryBlock));
+
+    // NOTE(sen) Small heaps (integrated parts, the BAR window) don't get a whole block
+    VkPhysicalDeviceMemoryProperties* memProperties = &heap->caps->memProperties;
+    VkDeviceSize heapSize = memProperties->memoryHeaps[memProperties->memoryTypes[memoryTypeIndex].heapIndex].size;
+    VkDeviceSize size = heap->blockSize;
+    if (size > heapSize / 8) {
+        size = heapSize / 8;
+    }
+    if (size < minSize) {
+        size = minSize;
+    }
 
-    m4 result = { x, 0.0f, 0.0f, 0.0f,
-                  0.0f, y, 0.0f, 0.0f,
-                  0.0f, 0.0f, z, 0.0f,
-                  0.0f, 0.0f, 0.0f, 1.0f };
-    return result;
+    VkMemoryAllocateInfo allocInfo;
+    zero(allocInfo);
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    {
+        VkResult result = vkAllocateMemory(heap->device, &allocInfo, getHostCallbacks(HostScope_Device), &deviceBlock->memory);
+        assert(result == VK_SUCCESS);
+    }
+
+    deviceBlock->memoryTypeIndex = memoryTypeIndex;
+    deviceBlock->linear = linear;
+    block->live = true;
+    block->group = getDeviceBlockGroup(heap, memoryTypeIndex, linear);
+    initFreeList(&block->freeList, size);
+    heap->reservedBytes[getMemoryHeapIndex(heap, memoryTypeIndex)] += size;
+    heap->reservedBlocks++;
+
+    VkMemoryPropertyFlags flags = memProperties->memoryTypes[memoryTypeIndex].propertyFlags;
+    if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VkResult result = vkMapMemory(heap->device, deviceBlock->memory, 0, VK_WHOLE_SIZE, 0, (void**)&deviceBlock->mapped);
+        assert(result == VK_SUCCESS);
+    }
+    return blockIndex;
+}
+
+// NOTE(sen) For memory the heap doesn't allocate itself, bytes can be negative
+void
+trackDeviceMemory(DeviceHeap* heap, MemoryCategory category, i64 bytes, i32 allocations) {
+    MemoryCategoryStats* stats = heap->categories + category;
+    stats->bytes += bytes;
+    stats->allocations += allocations;
+    if (stats->bytes > stats->peakBytes) {
+        stats->peakBytes = stats->bytes;
+    }
 }
 
-m4
-m4lookat(v3 eye, v3 target, v3 up) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
-
-    m4 result = { 0 };
-
-    f32 length = 0.0f;
-    f32 ilength = 0.0f;
-
-    // Vector3Subtract(eye, target)
-    v3 vz = { eye.x - target.x, eye.y - target.y, eye.z - target.z };
-
-    // Vector3Normalize(vz)
-    v3 v = vz;
-    length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
-    if (length == 0.0f) length = 1.0f;
-    ilength = 1.0f / length;
-    vz.x *= ilength;
-    vz.y *= ilength;
-    vz.z *= ilength;
-
-    // Vector3CrossProduct(up, vz)
-    v3 vx = { up.y * vz.z - up.z * vz.y, up.z * vz.x - up.x * vz.z, up.x * vz.y - up.y * vz.x };
-
-    // Vector3Normalize(x)
-    v = vx;
-    length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
-    if (length == 0.0f) length = 1.0f;
-    ilength = 1.0f / length;
-    vx.x *= ilength;
-    vx.y *= ilength;
-    vx.z *= ilength;
-
-    // Vector3CrossProduct(vz, vx)
-    v3 vy = { vz.y * vx.z - vz.z * vx.y, vz.z * vx.x - vz.x * vx.z, vz.x * vx.y - vz.y * vx.x };
-
-    result.m0 = vx.x;
-    result.m1 = vy.x;
-    result.m2 = vz.x;
-    result.m3 = 0.0f;
-    result.m4 = vx.y;
-    result.m5 = vy.y;
-    result.m6 = vz.y;
-    result.m7 = 0.0f;
-    result.m8 = vx.z;
-    result.m9 = vy.z;
-    result.m10 = vz.z;
-    result.m11 = 0.0f;
-    result.m12 = -(vx.x * eye.x + vx.y * eye.y + vx.z * eye.z);   // Vector3DotProduct(vx, eye)
-    result.m13 = -(vy.x * eye.x + vy.y * eye.y + vy.z * eye.z);   // Vector3DotProduct(vy, eye)
-    result.m14 = -(vz.x * eye.x + vz.y * eye.y + vz.z * eye.z);   // Vector3DotProduct(vz, eye)
-    result.m15 = 1.0f;
+// NOTE(sen) A range in one of the existing blocks, false when none has room. Blocks being
+// emptied by compaction are skipped.
+b32
+findDeviceMemoryRange(
+    DeviceHeap* heap, VkMemoryRequirements requirements, u32 memoryTypeIndex, b32 linear,
+    u32* blockIndex, VkDeviceSize* offset
+) {
+    b32 found = allocMemoryBlocks(
+        heap->blocks, heap->blockCount, getDeviceBlockGroup(heap, memoryTypeIndex, linear),
+        requirements.size, requirements.alignment, blockIndex, offset
+    );
+    return found;
+}
 
+// NOTE(sen) Compaction only moves buffers it knows the owners of, see relocateSwapChainBuffers.
+// Only those get created with the transfer usage the copy needs.
+b32
+isRelocatable(MemoryCategory category, b32 linear) {
+    b32 result = linear && (category == MemoryCategory_Geometry || category == MemoryCategory_Uniforms);
     return result;
 }
 
-m4
-m4perspective(f32 fovYRadians, f32 aspect, f32 nearPlane, f32 farPlane) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+void
+fillDeviceAllocation(
+    DeviceHeap* heap, u32 blockIndex, VkDeviceSize offset, VkDeviceSize size,
+    b32 linear, MemoryCategory category, DeviceAllocation* allocation
+) {
+    MemoryBlock* block = heap->blocks + blockIndex;
+    DeviceMemoryBlock* deviceBlock = heap->deviceBlocks + blockIndex;
+    ZeroMemory(allocation, sizeof(DeviceAllocation));
+    allocation->memory = deviceBlock->memory;
+    allocation->offset = offset;
+    allocation->size = size;
+    allocation->blockIndex = blockIndex;
+    allocation->category = category;
+    allocation->linear = linear;
+    if (deviceBlock->mapped) {
+        allocation->mapped = deviceBlock->mapped + offset;
+    }
+    if (!isRelocatable(category, linear)) {
+        block->pinnedCount++;
+    }
+    trackDeviceMemory(heap, category, size, 1);
+}
 
-    m4 result = { 0 };
+// NOTE(sen) linear is true for buffers and false for optimal tiling images
+void
+allocDeviceMemory(
+    DeviceHeap* heap, VkMemoryRequirements requirements, VkMemoryPropertyFlags properties,
+    b32 linear, MemoryCategory category, DeviceAllocation* allocation
+) {
+    u32 memoryTypeIndex = findMemoryTypeIndex(heap->caps, requirements.memoryTypeBits, properties);
+    u32 blockIndex = 0;
+    VkDeviceSize offset = 0;
+    if (!findDeviceMemoryRange(heap, requirements, memoryTypeIndex, linear, &blockIndex, &offset)) {
+        blockIndex = createDeviceMemoryBlock(heap, memoryTypeIndex, linear, requirements.size);
+        b32 found = allocFreeList(&heap->blocks[blockIndex].freeList, requirements.size, requirements.alignment, &offset);
+        assert(found);
+    }
+    fillDeviceAllocation(heap, blockIndex, offset, requirements.size, linear, category, allocation);
+}
 
-    f32 top = nearPlane * tanf(fovYRadians * 0.5f);
-    f32 bottom = -top;
-    f32 right = top * aspect;
-    f32 left = -right;
+// NOTE(sen) Empty blocks bigger than the usual size were made for one resource, those go
+// back to the driver. The rest are kept for reuse.
+void
+freeDeviceMemory(DeviceHeap* heap, DeviceAllocation* allocation) {
+    if (allocation->memory == VK_NULL_HANDLE) {
+        return;
+    }
+    MemoryBlock* block = heap->blocks + allocation->blockIndex;
+    assert(heap->deviceBlocks[allocation->blockIndex].memory == allocation->memory);
+    releaseFreeList(&block->freeList, allocation->offset, allocation->size);
+    trackDeviceMemory(heap, allocation->category, -(i64)allocation->size, -1);
+    if (!isRelocatable(allocation->category, allocation->linear)) {
+        assert(block->pinnedCount > 0);
+        block->pinnedCount--;
+    }
+    if (block->freeList.used == 0 && block->freeList.size > heap->blockSize) {
+        destroyDeviceMemoryBlock(heap, allocation->blockIndex);
+    }
+    ZeroMemory(allocation, sizeof(DeviceAllocation));
+}
 
-    f32 rl = right - left;
-    f32 tb = top - bottom;
-    f32 fn = farPlane - nearPlane;
+u32
+getLiveAllocationCount(DeviceHeap* heap) {
+    u32 result = 0;
+    for (u32 category = 0; category < MemoryCategory_Count; category++) {
+        result += heap->categories[category].allocations;
+    }
+    return result;
+}
 
-    result.m0 = (nearPlane * 2.0f) / rl;
-    result.m5 = (nearPlane * 2.0f) / tb;
-    result.m8 = (right + left) / rl;
-    result.m9 = (top + bottom) / tb;
-    result.m10 = -(farPlane + nearPlane) / fn;
-    result.m11 = -1.0f;
-    result.m14 = -(farPlane * nearPlane * 2.0f) / fn;
+// NOTE(sen) Driver view of each memory heap, what every process is using and how much of it
+// this one can have before it starts getting evicted. False without VK_EXT_memory_budget.
+b32
+getMemoryBudget(DeviceCaps* caps, VkPhysicalDeviceMemoryBudgetPropertiesEXT* budget) {
+    b32 result = false;
+    if (caps->memoryBudget) {
+        ZeroMemory(budget, sizeof(VkPhysicalDeviceMemoryBudgetPropertiesEXT));
+        budget->sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 properties;
+        zero(properties);
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = budget;
+        caps->getMemoryProperties2(caps->physicalDevice, &properties);
+        result = true;
+    }
+    return result;
+}
 
+char*
+getMemoryCategoryName(MemoryCategory category) {
+    char* result = "";
+    switch (category) {
+    case MemoryCategory_SwapChain: result = "swapchain"; break;
+    case MemoryCategory_Depth: result = "depth"; break;
+    case MemoryCategory_Uniforms: result = "uniforms"; break;
+    case MemoryCategory_Geometry: result = "geometry"; break;
+    case MemoryCategory_Textures: result = "textures"; break;
+    case MemoryCategory_Staging: result = "staging"; break;
+    default: break;
+    }
     return result;
 }
 
+HeapFragmentation
+getHeapFragmentation(DeviceHeap* heap) {
+    HeapFragmentation result = { 0 };
+    for (u32 index = 0; index < heap->blockCount; index++) {
+        MemoryBlock* block = heap->blocks + index;
+        if (block->live) {
+            FreeList* list = &block->freeList;
+            result.reservedBytes += list->size;
+            result.usedBytes += list->used;
+            result.freeBytes += list->size - list->used;
+            result.freeRanges += list->count;
+            result.blockCount++;
+            u64 largest = getFreeListLargest(list);
+            if (largest > result.largestFreeBytes) {
+                result.largestFreeBytes = largest;
+            }
+        }
+    }
+    return result;
+}
 
-m4
-m4mul(m4 left, m4 right) {
-    // Taken from
-    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+// NOTE(sen) 0 when all the free space is one range, approaches 1 as it gets split up
+f32
+getFragmentationRatio(HeapFragmentation* fragmentation) {
+    f32 result = 0.0f;
+    if (fragmentation->freeBytes > 0) {
+        result = 1.0f - (f32)fragmentation->largestFreeBytes / (f32)fragmentation->freeBytes;
+    }
+    return result;
+}
 
-    m4 result = { 0 };
+u32
+formatHeapFragmentation(HeapFragmentation* fragmentation, char* buffer, u32 size) {
+    f64 mb = 1.0 / (1024.0 * 1024.0);
+    i32 length = snprintf(
+        buffer, size, "%u blocks, %.2f of %.2f MB used, %.2f MB free in %u ranges, largest %.2f MB (%.0f%% fragmented)\n",
+        fragmentation->blockCount, (f64)fragmentation->usedBytes * mb, (f64)fragmentation->reservedBytes * mb,
+        (f64)fragmentation->freeBytes * mb, fragmentation->freeRanges, (f64)fragmentation->largestFreeBytes * mb,
+        getFragmentationRatio(fragmentation) * 100.0f
+    );
+    return (u32)length < size ? (u32)length : size - 1;
+}
 
-    result.m0 = left.m0 * right.m0 + left.m1 * right.m4 + left.m2 * right.m8 + left.m3 * right.m12;
-    result.m1 = left.m0 * right.m1 + left.m1 * right.m5 + left.m2 * right.m9 + left.m3 * right.m13;
-    result.m2 = left.m0 * right.m2 + left.m1 * right.m6 + left.m2 * right.m10 + left.m3 * right.m14;
-    result.m3 = left.m0 * right.m3 + left.m1 * right.m7 + left.m2 * right.m11 + left.m3 * right.m15;
-    result.m4 = left.m4 * right.m0 + left.m5 * right.m4 + left.m6 * right.m8 + left.m7 * right.m12;
-    result.m5 = left.m4 * right.m1 + left.m5 * right.m5 + left.m6 * right.m9 + left.m7 * right.m13;
-    result.m6 = left.m4 * right.m2 + left.m5 * right.m6 + left.m6 * right.m10 + left.m7 * right.m14;
-    result.m7 = left.m4 * right.m3 + left.m5 * right.m7 + left.m6 * right.m11 + left.m7 * right.m15;
-    result.m8 = left.m8 * right.m0 + left.m9 * right.m4 + left.m10 * right.m8 + left.m11 * right.m12;
-    result.m9 = left.m8 * right.m1 + left.m9 * right.m5 + left.m10 * right.m9 + left.m11 * right.m13;
-    result.m10 = left.m8 * right.m2 + left.m9 * right.m6 + left.m10 * right.m10 + left.m11 * right.m14;
-    result.m11 = left.m8 * right.m3 + left.m9 * right.m7 + left.m10 * right.m11 + left.m11 * right.m15;
-    result.m12 = left.m12 * right.m0 + left.m13 * right.m4 + left.m14 * right.m8 + left.m15 * right.m12;
-    result.m13 = left.m12 * right.m1 + left.m13 * right.m5 + left.m14 * right.m9 + left.m15 * right.m13;
-    result.m14 = left.m12 * right.m2 + left.m13 * right.m6 + left.m14 * right.m10 + left.m15 * right.m14;
-    result.m15 = left.m12 * right.m3 + left.m13 * right.m7 + left.m14 * right.m11 + left.m15 * right.m15;
+// NOTE(sen) Human readable dump of the accounting, returns the length written
+u32
+formatMemoryReport(DeviceHeap* heap, char* buffer, u32 size) {
+    f64 mb = 1.0 / (1024.0 * 1024.0);
+    u32 length = 0;
+    length += snprintf(buffer + length, size - length, "%-10s %10s %10s %6s\n", "memory", "live MB", "peak MB", "count");
+    for (u32 category = 0; category < MemoryCategory_Count && length < size; category++) {
+        MemoryCategoryStats* stats = heap->categories + category;
+        length += snprintf(
+            buffer + length, size - length, "%-10s %10.2f %10.2f %6u\n",
+            getMemoryCategoryName(category), (f64)stats->bytes * mb, (f64)stats->peakBytes * mb, stats->allocations
+        );
+    }
 
-    return result;
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget;
+    b32 haveBudget = getMemoryBudget(heap->caps, &budget);
+    VkPhysicalDeviceMemoryProperties* memProperties = &heap->caps->memProperties;
+    for (u32 heapIndex = 0; heapIndex < memProperties->memoryHeapCount && length < size; heapIndex++) {
+        length += snprintf(
+            buffer + length, size - length, "heap %u: %.2f of %.2f MB reserved",
+            heapIndex, (f64)heap->reservedBytes[heapIndex] * mb, (f64)memProperties->memoryHeaps[heapIndex].size * mb
+        );
+        if (haveBudget && length < size) {
+            length += snprintf(
+                buffer + length, size - length, ", process usage %.2f of %.2f MB budget",
+                (f64)budget.heapUsage[heapIndex] * mb, (f64)budget.heapBudget[heapIndex] * mb
+            );
+        }
+        if (length < size) {
+            length += snprintf(buffer + length, size - length, "\n");
+        }
+    }
+    if (length < size) {
+        length += snprintf(buffer + length, size - length, "%u vkAllocateMemory blocks live\n", heap->reservedBlocks);
+    }
+    if (length < size) {
+        HeapFragmentation fragmentation = getHeapFragmentation(heap);
+        length += formatHeapFragmentation(&fragmentation, buffer + length, size - length);
+    }
+    return length < size ? length : size - 1;
 }
 
 void
-printMsgName(u32 msg_code) {
-    char* name = findMsgName(msg_code);
-    if (name) {
-        char buffer[64];
-        snprintf(buffer, 64, "%s\n", name);
-        OutputDebugString(buffer);
+createBuffer(
+    DeviceHeap* heap,
+    VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+    MemoryCategory category, VkBuffer* buffer, DeviceAllocation* bufferMemory
+) {
+    VkBufferCreateInfo bufferInfo;
+    zero(bufferInfo);
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    // NOTE(sen) Compaction moves buffers with transfer copies
+    if (isRelocatable(category, true)) {
+        bufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    {
+        VkResult result = vkCreateBuffer(heap->device, &bufferInfo, getHostCallbacks(HostScope_Device), buffer);
+        assert(result == VK_SUCCESS);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(heap->device, *buffer, &memRequirements);
+    allocDeviceMemory(heap, memRequirements, properties, true, category, bufferMemory);
+    bufferMemory->bufferSize = size;
+    bufferMemory->bufferUsage = bufferInfo.usage;
+
+    assert(vkBindBufferMemory(heap->device, *buffer, bufferMemory->memory, bufferMemory->offset) == VK_SUCCESS);
+}
+
+void
+destroyBuffer(DeviceHeap* heap, VkBuffer buffer, DeviceAllocation* bufferMemory) {
+    vkDestroyBuffer(heap->device, buffer, getHostCallbacks(HostScope_Device));
+    freeDeviceMemory(heap, bufferMemory);
+}
+
+// NOTE(sen) gpuData points into the block's mapping, it stays valid until the buffer is destroyed
+void
+createMappedBuffer(
+    DeviceHeap* heap,
+    VkDeviceSize dataSize,
+    VkBufferUsageFlags bufferUsage,
+    MemoryCategory category,
+    VkBuffer* buffer,
+    DeviceAllocation* bufferMemory,
+    void** gpuData
+) {
+    createBuffer(
+        heap, dataSize,
+        bufferUsage,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        category, buffer, bufferMemory
+    );
+    *gpuData = bufferMemory->mapped;
+}
+
+// NOTE(sen) Host visible memory that isn't HOST_CACHED is write-combined on most drivers
+b32
+isAllocationUncached(DeviceHeap* heap, DeviceAllocation* allocation) {
+    u32 memIndex = heap->deviceBlocks[allocation->blockIndex].memoryTypeIndex;
+    b32 result = (heap->caps->memProperties.memoryTypes[memIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) == 0;
+    return result;
+}
+
+// NOTE(sen) Compaction empties sparsely used blocks by moving their buffers into the free space
+// of the others, then gives the empty blocks back. beginHeapCompaction picks the blocks,
+// relocateBuffer is called for every buffer whose owner is known, endHeapCompaction cleans
+// up once the copies recorded in between have finished. The device must be idle throughout.
+// Returns the number of blocks marked, see markMemoryBlocksForCompaction.
+u32
+beginHeapCompaction(DeviceHeap* heap) {
+    assert(heap->retiredCount == 0);
+    u32 marked = markMemoryBlocksForCompaction(heap->blocks, heap->blockCount, heap->blockSize);
+    return marked;
+}
+
+// NOTE(sen) Moves a buffer out of a block being evacuated. The contents follow through the
+// mapping when the memory is host visible and through a copy recorded in commandBuffer when
+// it isn't. The owner's handle and allocation are replaced, the old ones live until
+// endHeapCompaction. Returns true when the buffer moved, pointers into the old mapping then
+// have to be refreshed from allocation->mapped.
+b32
+relocateBuffer(DeviceHeap* heap, VkCommandBuffer commandBuffer, VkBuffer* buffer, DeviceAllocation* allocation) {
+    if (allocation->memory == VK_NULL_HANDLE || !heap->blocks[allocation->blockIndex].evacuating) {
+        return false;
+    }
+    assert(isRelocatable(allocation->category, allocation->linear) && allocation->bufferSize > 0);
+    u32 memoryTypeIndex = heap->deviceBlocks[allocation->blockIndex].memoryTypeIndex;
+
+    VkBufferCreateInfo bufferInfo;
+    zero(bufferInfo);
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = allocation->bufferSize;
+    bufferInfo.usage = allocation->bufferUsage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer newBuffer;
+    {
+        VkResult result = vkCreateBuffer(heap->device, &bufferInfo, getHostCallbacks(HostScope_Device), &newBuffer);
+        assert(result == VK_SUCCESS);
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(heap->device, newBuffer, &memRequirements);
+    assert(memRequirements.memoryTypeBits & (1 << memoryTypeIndex));
+    u32 blockIndex = 0;
+    VkDeviceSize offset = 0;
+    if (!findDeviceMemoryRange(heap, memRequirements, memoryTypeIndex, true, &blockIndex, &offset)) {
+        vkDestroyBuffer(heap->device, newBuffer, getHostCallbacks(HostScope_Device));
+        return false;
+    }
+    DeviceAllocation newMemory;
+    fillDeviceAllocation(heap, blockIndex, offset, memRequirements.size, true, allocation->category, &newMemory);
+    newMemory.bufferSize = allocation->bufferSize;
+    newMemory.bufferUsage = allocation->bufferUsage;
+    assert(vkBindBufferMemory(heap->device, newBuffer, newMemory.memory, newMemory.offset) == VK_SUCCESS);
+
+    if (newMemory.mapped && allocation->mapped) {
+        memcpy(newMemory.mapped, allocation->mapped, allocation->bufferSize);
     } else {
-        OutputDebugString("MSG UNRECOGNIZED\n");
+        VkBufferCopy region = { 0 };
+        region.size = allocation->bufferSize;
+        vkCmdCopyBuffer(commandBuffer, *buffer, newBuffer, 1, &region);
     }
+
+    if (heap->retiredCount == heap->retiredCapacity) {
+        heap->retiredCapacity = heap->retiredCapacity ? heap->retiredCapacity * 2 : 64;
+        heap->retired = realloc(heap->retired, sizeof(RetiredBuffer) * heap->retiredCapacity);
+    }
+    RetiredBuffer* retired = heap->retired + heap->retiredCount++;
+    retired->buffer = *buffer;
+    retired->memory = *allocation;
+    *buffer = newBuffer;
+    *allocation = newMemory;
+    return true;
 }
 
-LRESULT windowProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-    switch (msg) {
-    case WM_CLOSE: case WM_DESTROY: case WM_QUIT: {
-        globalRunning = false;
+// NOTE(sen) Returns how many blocks went back to the driver. A block stays when something in
+// it wasn't relocated.
+u32
+endHeapCompaction(DeviceHeap* heap) {
+    for (u32 index = 0; index < heap->retiredCount; index++) {
+        RetiredBuffer* retired = heap->retired + index;
+        destroyBuffer(heap, retired->buffer, &retired->memory);
+    }
+    heap->retiredCount = 0;
+
+    u32 released = 0;
+    for (u32 index = 0; index < heap->blockCount; index++) {
+        if (endMemoryBlockEvacuation(heap->blocks + index)) {
+            destroyDeviceMemoryBlock(heap, index);
+            released++;
+        }
+    }
+    return released;
+}
+
+// NOTE(sen) Binding 0 per vertex, locations match shader.vert (built with NO_VERTEX_COLOR
+// for VertexFormat_HalfNoColor). Returns the number of attributes written, at most 3.
+u32
+getVertexInputDescription(
+    VertexFormat format,
+    VkVertexInputBindingDescription* binding,
+    VkVertexInputAttributeDescription* attributes
+) {
+    ZeroMemory(binding, sizeof(VkVertexInputBindingDescription));
+    binding->binding = 0;
+    binding->stride = getVertexSize(format);
+    binding->inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    ZeroMemory(attributes, sizeof(VkVertexInputAttributeDescription) * 3);
+    attributes[0].location = 0;
+    attributes[1].location = 1;
+    attributes[2].location = 2;
+
+    u32 result = 3;
+    switch (format) {
+    case VertexFormat_F32: {
+        attributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributes[0].offset = offsetof(Vertex, pos);
+        attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+        attributes[1].offset = offsetof(Vertex, color);
+        attributes[2].format = VK_FORMAT_R32G32_SFLOAT;
+        attributes[2].offset = offsetof(Vertex, texture);
     } break;
-    case WM_ERASEBKGND: {
-        return 1; // NOTE(sen) Prevents flickering
+    case VertexFormat_Half: case VertexFormat_Snorm16: {
+        attributes[0].format = format == VertexFormat_Half ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R16G16B16A16_SNORM;
+        attributes[0].offset = offsetof(VertexPacked, pos);
+        attributes[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+        attributes[1].offset = offsetof(VertexPacked, color);
+        attributes[2].format = VK_FORMAT_R16G16_UNORM;
+        attributes[2].offset = offsetof(VertexPacked, texture);
     } break;
-    case WM_NCCALCSIZE: {
-        return 0; // NOTE(sen) Removes window decorations
+    case VertexFormat_HalfNoColor: {
+        attributes[0].format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        attributes[0].offset = offsetof(VertexPackedNoColor, pos);
+        attributes[1].location = 2;
+        attributes[1].format = VK_FORMAT_R16G16_UNORM;
+        attributes[1].offset = offsetof(VertexPackedNoColor, texture);
+        result = 2;
     } break;
     }
-    return DefWindowProcW(hWnd, msg, wParam, lParam);
+    return result;
 }
 
-Rect
-moveRect(Rect rect, f32 byx, f32 byy, f32 byz) {
-    Rect result = rect;
-    result.topleft.x += byx;
-    result.topleft.y += byy;
-    result.topleft.z += byz;
-    result.bottomright.x += byx;
-    result.bottomright.y += byy;
-    result.bottomright.z += byz;
+// NOTE(sen) "-format f32|half|snorm16|nocolor" on the command line picks the layout of the
+// non-instanced geometry. Half is the default: half the vertex bandwidth of F32 for
+// roughly 2-3x the CPU time in pushRects, see bench.c.
+VertexFormat
+parseVertexFormat(char* cmdLine, VertexFormat fallback) {
+    VertexFormat result = fallback;
+    char* option = strstr(cmdLine, "-format ");
+    if (option) {
+        char* name = option + strlen("-format ");
+        usize nameLength = strcspn(name, " \t");
+        char* names[] = { "f32", "half", "snorm16", "nocolor" };
+        VertexFormat formats[] = { VertexFormat_F32, VertexFormat_Half, VertexFormat_Snorm16, VertexFormat_HalfNoColor };
+        b32 found = false;
+        for (u32 index = 0; index < arrayCount(names); index++) {
+            if (strlen(names[index]) == nameLength && strncmp(name, names[index], nameLength) == 0) {
+                result = formats[index];
+                found = true;
+            }
+        }
+        if (!found) {
+            OutputDebugString("unknown -format, expected f32, half, snorm16 or nocolor\n");
+        }
+    }
     return result;
 }
 
+// NOTE(sen) Without an index buffer the geometry only counts indices, see QuadIndexBuffer.
+// Device-local buffers only go with the shared quad indices, uploads are vertices only.
 void
-pushRect(VertexIndexBuffer* buffer, Rect rect) {
+createVertexIndexBuffer(
+    VertexIndexBuffer* buf,
+    DeviceHeap* heap,
+    VertexFormat format,
+    u32 vertexCapacity,
+    b32 withIndexBuffer,
+    GeometryPlacement placement
+) {
+    ZeroMemory(buf, sizeof(VertexIndexBuffer));
+    buf->placement = placement;
+    buf->geometry.format = format;
+    buf->geometry.vertexCapacity = vertexCapacity;
+    buf->geometry.indexCapacity = vertexCapacity / 4 * 6;
+    buf->geometry.index32 = withIndexBuffer && vertexCapacity > 65536;
+    VkDeviceSize indexSize = buf->geometry.index32 ? sizeof(u32) : sizeof(u16);
+
+    if (placement == GeometryPlacement_DeviceLocal) {
+        assert(!withIndexBuffer);
+        VkDeviceSize vertexBytes = getVertexSize(format) * vertexCapacity;
+        createBuffer(
+            heap, vertexBytes,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory_Geometry,
+            &buf->vertexBuffer, &buf->vertexMemory
+        );
+        buf->geometry.vertexBytes = malloc(vertexBytes);
+        return;
+    }
 
-    assert(rect.topleft.z == rect.bottomright.z);
+    createMappedBuffer(
+        heap,
+        getVertexSize(format) * vertexCapacity,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory_Geometry,
+        &buf->vertexBuffer, &buf->vertexMemory,
+        &buf->geometry.vertexData
+    );
+    buf->geometry.streamingStores = isAllocationUncached(heap, &buf->vertexMemory);
 
-    v3 black = { 0 };
+    if (withIndexBuffer) {
+        createMappedBuffer(
+            heap,
+            indexSize * buf->geometry.indexCapacity,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryCategory_Geometry,
+            &buf->indexBuffer, &buf->indexMemory,
+            &buf->geometry.indexData
+        );
+    }
+}
 
-    buffer->vertexData[buffer->curVertex].pos = rect.topleft;
-    buffer->vertexData[buffer->curVertex].color = black;
-    buffer->vertexData[buffer->curVertex].texture = rect.textopleft;
+void
+destroyVertexIndexBuffer(VertexIndexBuffer* buf, DeviceHeap* heap) {
+    if (buf->placement == GeometryPlacement_DeviceLocal) {
+        free(buf->geometry.vertexBytes);
+    }
+    if (buf->indexBuffer != VK_NULL_HANDLE) {
+        destroyBuffer(heap, buf->indexBuffer, &buf->indexMemory);
+    }
+    destroyBuffer(heap, buf->vertexBuffer, &buf->vertexMemory);
+}
 
-    v3 topright = rect.topleft;
-    topright.x = rect.bottomright.x;
+void
+relocateVertexIndexBuffer(VertexIndexBuffer* buf, DeviceHeap* heap, VkCommandBuffer commandBuffer) {
+    if (
+        relocateBuffer(heap, commandBuffer, &buf->vertexBuffer, &buf->vertexMemory)
+        && buf->placement == GeometryPlacement_HostVisible
+    ) {
+        buf->geometry.vertexData = buf->vertexMemory.mapped;
+    }
+    if (buf->indexBuffer != VK_NULL_HANDLE && relocateBuffer(heap, commandBuffer, &buf->indexBuffer, &buf->indexMemory)) {
+        buf->geometry.indexData = buf->indexMemory.mapped;
+    }
+}
 
-    v2 textopright = rect.textopleft;
-    textopright.x = rect.texbottomright.x;
+void
+initGeometryStream(
+    GeometryStream* stream,
+    DeviceHeap* heap,
+    QuadIndexBuffer* quadIndices,
+    VertexFormat format,
+    u32 vertexCapacity
+) {
+    stream->heap = heap;
+    stream->quadIndices = quadIndices;
+    stream->format = format;
+    stream->blocks = malloc(sizeof(VertexIndexBuffer));
+    stream->blockCount = 1;
+    stream->usedBlocks = 1;
+    createVertexIndexBuffer(stream->blocks, heap, format, vertexCapacity, quadIndices == 0, GeometryPlacement_HostVisible);
+}
 
-    buffer->vertexData[buffer->curVertex + 1].pos = topright;
-    buffer->vertexData[buffer->curVertex + 1].color = black;
-    buffer->vertexData[buffer->curVertex + 1].texture = textopright;
+void
+destroyGeometryStream(GeometryStream* stream) {
+    for (u32 index = 0; index < stream->blockCount; index++) {
+        destroyVertexIndexBuffer(stream->blocks + index, stream->heap);
+    }
+    free(stream->blocks);
+    stream->blocks = 0;
+    stream->blockCount = 0;
+    stream->usedBlocks = 0;
+}
 
-    v3 bottomleft = rect.bottomright;
-    bottomleft.x = rect.topleft.x;
+// NOTE(sen) Call once the image's previous frame is done on the GPU. Blocks are merged
+// into one only when a single block can hold last frame's geometry, past the quad index
+// cap the frame needs several blocks anyway so the existing ones are kept as they are.
+void
+beginGeometryStream(GeometryStream* stream) {
+    if (stream->usedBlocks > 1) {
+        u32 needed = 0;
+        for (u32 index = 0; index < stream->usedBlocks; index++) {
+            needed += stream->blocks[index].geometry.curVertex;
+        }
+        u32 capacity = stream->blocks[0].geometry.vertexCapacity;
+        u32 maxCapacity = stream->quadIndices ? stream->quadIndices->quadCapacity * 4 : UINT32_MAX / 2;
+        while (capacity < needed && capacity < maxCapacity) {
+            capacity *= 2;
+        }
+        if (capacity >= needed) {
+            DeviceHeap* heap = stream->heap;
+            QuadIndexBuffer* quadIndices = stream->quadIndices;
+            VertexFormat format = stream->format;
+            destroyGeometryStream(stream);
+            initGeometryStream(stream, heap, quadIndices, format, capacity);
+        }
+    }
+    stream->usedBlocks = 1;
+    stream->blocks[0].geometry.curVertex = 0;
+    stream->blocks[0].geometry.curIndex = 0;
+}
 
-    v2 texbottomleft = rect.texbottomright;
-    texbottomleft.x = rect.textopleft.x;
+// NOTE(sen) Returns a block with room for at least one more rect
+GeometryBuffer*
+reserveGeometryRect(GeometryStream* stream) {
+    GeometryBuffer* current = &stream->blocks[stream->usedBlocks - 1].geometry;
+    if (getGeometryRectRoom(current) == 0) {
+        if (stream->usedBlocks == stream->blockCount) {
+            u32 capacity = current->vertexCapacity;
+            stream->blocks = realloc(stream->blocks, sizeof(VertexIndexBuffer) * (stream->blockCount + 1));
+            createVertexIndexBuffer(
+                stream->blocks + stream->blockCount, stream->heap,
+                stream->format, capacity, stream->quadIndices == 0, GeometryPlacement_HostVisible
+            );
+            stream->blockCount++;
+        }
+        current = &stream->blocks[stream->usedBlocks++].geometry;
+        current->curVertex = 0;
+        current->curIndex = 0;
+    }
+    return current;
+}
 
-    buffer->vertexData[buffer->curVertex + 2].pos = bottomleft;
-    buffer->vertexData[buffer->curVertex + 2].color = black;
-    buffer->vertexData[buffer->curVertex + 2].texture = texbottomleft;
+void
+streamRects(GeometryStream* stream, Rect* rects, usize count, m4 transform) {
+    usize done = 0;
+    while (done < count) {
+        GeometryBuffer* geometry = reserveGeometryRect(stream);
+        usize chunk = getGeometryRectRoom(geometry);
+        if (chunk > count - done) {
+            chunk = count - done;
+        }
+        pushRects(geometry, rects + done, chunk, transform);
+        done += chunk;
+    }
+}
 
-    buffer->vertexData[buffer->curVertex + 3].pos = rect.bottomright;
-    buffer->vertexData[buffer->curVertex + 3].color = black;
-    buffer->vertexData[buffer->curVertex + 3].texture = rect.texbottomright;
+// NOTE(sen) Same as streamRects but each block's chunk is generated on the job queue
+void
+streamRectsParallel(GeometryStream* stream, JobQueue* queue, Rect* rects, usize count, m4 transform, b32 deterministic) {
+    usize done = 0;
+    while (done < count) {
+        GeometryBuffer* geometry = reserveGeometryRect(stream);
+        usize chunk = getGeometryRectRoom(geometry);
+        if (chunk > count - done) {
+            chunk = count - done;
+        }
+        pushRectsParallel(queue, geometry, rects + done, chunk, transform, deterministic);
+        done += chunk;
+    }
+}
 
-    buffer->indexData[buffer->curIndex + 0] = buffer->curVertex + 0;
-    buffer->indexData[buffer->curIndex + 1] = buffer->curVertex + 1;
-    buffer->indexData[buffer->curIndex + 2] = buffer->curVertex + 2;
-    buffer->indexData[buffer->curIndex + 3] = buffer->curVertex + 1;
-    buffer->indexData[buffer->curIndex + 4] = buffer->curVertex + 3;
-    buffer->indexData[buffer->curIndex + 5] = buffer->curVertex + 2;
+void
+initQuadInstanceStream(QuadInstanceStream* stream, DeviceHeap* heap, u32 capacity) {
+    ZeroMemory(stream, sizeof(QuadInstanceStream));
+    stream->heap = heap;
+    stream->instances.capacity = capacity;
+    createMappedBuffer(
+        heap,
+        sizeof(QuadInstance) * capacity,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MemoryCategory_Geometry,
+        &stream->buffer, &stream->memory,
+        &stream->instances.data
+    );
+}
 
-    buffer->curVertex += 4;
-    buffer->curIndex += 6;
+void
+destroyQuadInstanceStream(QuadInstanceStream* stream) {
+    destroyBuffer(stream->heap, stream->buffer, &stream->memory);
 }
 
-VkShaderModule
-createShaderModule(char* filename, VkDevice device) {
-    FILE* file;
-    fopen_s(&file, filename, "rb");
-    fseek(file, 0, SEEK_END);
-    i32 fileSize = ftell(file);
-    void* contents = malloc(fileSize);
-    fseek(file, 0, SEEK_SET);
-    usize read = fread(contents, fileSize, 1, file);
-    assert(read == 1);
-    fclose(file);
-    VkShaderModuleCreateInfo createInfo;
-    ZeroMemory(&createInfo, sizeof(VkShaderModuleCreateInfo));
-    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = fileSize;
-    createInfo.pCode = (u32*)(contents);
-    VkShaderModule shaderModule;
-    VkResult result = vkCreateShaderModule(device, &createInfo, 0, &shaderModule);
+// NOTE(sen) Call once the image's previous frame is done on the GPU
+void
+beginQuadInstanceStream(QuadInstanceStream* stream) {
+    stream->instances.count = 0;
+}
+
+void
+streamQuadInstances(QuadInstanceStream* stream, Rect* rects, usize count, u32 color) {
+    u32 needed = stream->instances.count + (u32)count;
+    if (needed > stream->instances.capacity) {
+        // NOTE(sen) Nothing is recorded against this buffer yet, so it can be replaced.
+        // Reads back from mapped memory but only happens while the capacity settles.
+        u32 capacity = stream->instances.capacity;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        QuadInstanceStream old = *stream;
+        initQuadInstanceStream(stream, old.heap, capacity);
+        CopyMemory(stream->instances.data, old.instances.data, sizeof(QuadInstance) * old.instances.count);
+        stream->instances.count = old.instances.count;
+        destroyQuadInstanceStream(&old);
+    }
+    pushQuadInstances(&stream->instances, rects, count, color);
+}
+
+void
+initTransientBuffer(TransientBuffer* transient, DeviceHeap* heap, VkDeviceSize segmentSize, u32 segmentCount) {
+    ZeroMemory(transient, sizeof(TransientBuffer));
+    transient->uniformAlignment = heap->caps->properties.limits.minUniformBufferOffsetAlignment;
+    transient->segmentSize = alignUp(segmentSize, transient->uniformAlignment);
+    transient->segmentCount = segmentCount;
+    // NOTE(sen) Mapped once here, coherent or not, whichever host visible type comes first
+    createBuffer(
+        heap, transient->segmentSize * segmentCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+            | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, MemoryCategory_Uniforms,
+        &transient->buffer, &transient->memory
+    );
+    transient->data = transient->memory.mapped;
+    transient->streamingStores = isAllocationUncached(heap, &transient->memory);
+    u32 memIndex = heap->deviceBlocks[transient->memory.blockIndex].memoryTypeIndex;
+    transient->coherent = (heap->caps->memProperties.memoryTypes[memIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+void
+destroyTransientBuffer(TransientBuffer* transient, DeviceHeap* heap) {
+    destroyBuffer(heap, transient->buffer, &transient->memory);
+}
+
+void
+beginTransientSegment(TransientBuffer* transient, u32 segment) {
+    assert(segment < transient->segmentCount);
+    transient->segmentStart = segment * transient->segmentSize;
+    transient->cursor = transient->segmentStart;
+    transient->segmentEnd = transient->segmentStart + transient->segmentSize;
+}
+
+// NOTE(sen) Makes what was written into the current segment visible to the device when the
+// memory isn't coherent. Flush ranges are whole nonCoherentAtomSize units from the start of
+// the block, rounding out onto neighbouring allocations is harmless.
+void
+flushTransientBuffer(TransientBuffer* transient, DeviceHeap* heap) {
+    if (transient->coherent || transient->cursor == transient->segmentStart) {
+        return;
+    }
+    VkDeviceSize atom = heap->caps->properties.limits.nonCoherentAtomSize;
+    VkDeviceSize blockSize = heap->blocks[transient->memory.blockIndex].freeList.size;
+    VkDeviceSize start = transient->memory.offset + transient->segmentStart;
+    VkDeviceSize end = transient->memory.offset + transient->cursor;
+    VkMappedMemoryRange range;
+    zero(range);
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = transient->memory.memory;
+    range.offset = start / atom * atom;
+    end = (end + atom - 1) / atom * atom;
+    range.size = end >= blockSize ? VK_WHOLE_SIZE : end - range.offset;
+    VkResult result = vkFlushMappedMemoryRanges(heap->device, 1, &range);
     assert(result == VK_SUCCESS);
-    return shaderModule;
 }
 
-u32
-findMemoryTypeIndex(
-    VkPhysicalDevice physicalDevice,
-    u32 memoryTypeBits,
-    VkMemoryPropertyFlags properties
-) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-    i32 memIndex;
-    {
-        b32 found = false;
-        for (u32 index = 0; index < memProperties.memoryTypeCount; index++) {
-            b32 correctType = memoryTypeBits & (1 << index);
-            b32 correctProperties = (memProperties.memoryTypes[index].propertyFlags & properties) == properties;
-            if (correctType && correctProperties) {
-                found = true;
-                memIndex = index;
-                break;
+// NOTE(sen) Offset is from the start of the buffer, use it as the bind or dynamic offset.
+// Returns null when the segment is out of room.
+void*
+allocTransient(TransientBuffer* transient, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset) {
+    VkDeviceSize aligned = alignUp(transient->cursor, alignment);
+    void* result = 0;
+    if (aligned + size <= transient->segmentEnd) {
+        transient->cursor = aligned + size;
+        *offset = aligned;
+        result = transient->data + aligned;
+    }
+    return result;
+}
+
+void*
+allocTransientUniform(TransientBuffer* transient, VkDeviceSize size, u32* dynamicOffset) {
+    VkDeviceSize offset = 0;
+    void* result = allocTransient(transient, size, transient->uniformAlignment, &offset);
+    *dynamicOffset = (u32)offset;
+    return result;
+}
+
+// NOTE(sen) Records the copies that bring a device-local buffer's changed rects up to date
+// and makes them visible to vertex input. Has to go outside the render pass. Returns false
+// when the segment ran out of room, some runs are left out then.
+b32
+cmdUploadRectRuns(VkCommandBuffer commandBuffer, TransientBuffer* transient, VertexIndexBuffer* buf, RectRun* runs, u32 runCount) {
+    assert(buf->placement == GeometryPlacement_DeviceLocal);
+    if (runCount == 0) {
+        return true;
+    }
+
+    StagedCopy copies[64];
+    b32 result = true;
+    for (u32 first = 0; first < runCount && result; first += arrayCount(copies)) {
+        u32 count = runCount - first;
+        if (count > arrayCount(copies)) {
+            count = arrayCount(copies);
+        }
+        u64 used = stageRectRuns(
+            &buf->geometry, runs + first, count,
+            transient->data, transient->cursor, transient->segmentEnd, transient->streamingStores, copies
+        );
+        if (used == 0) {
+            result = false;
+        } else {
+            transient->cursor += used;
+            VkBufferCopy regions[arrayCount(copies)];
+            for (u32 index = 0; index < count; index++) {
+                regions[index].srcOffset = copies[index].srcOffset;
+                regions[index].dstOffset = copies[index].dstOffset;
+                regions[index].size = copies[index].size;
             }
+            vkCmdCopyBuffer(commandBuffer, transient->buffer, buf->vertexBuffer, count, regions);
+        }
+    }
+
+    // NOTE(sen) Earlier chunks may have been recorded before running out, those still need this
+    VkMemoryBarrier barrier;
+    zero(barrier);
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        0, 1, &barrier, 0, 0, 0, 0
+    );
+    return result;
+}
+
+// NOTE(sen) Device-local geometry only pays off when there is memory the CPU can't see,
+// on integrated parts everything device-local is host visible anyway
+GeometryPlacement
+getStaticGeometryPlacement(DeviceCaps* caps) {
+    GeometryPlacement result = GeometryPlacement_HostVisible;
+    for (u32 index = 0; index < caps->memProperties.memoryTypeCount; index++) {
+        VkMemoryPropertyFlags flags = caps->memProperties.memoryTypes[index].propertyFlags;
+        if ((flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+            result = GeometryPlacement_DeviceLocal;
+            break;
         }
-        assert(found);
     }
-    return memIndex;
+    return result;
 }
 
 void
-createBuffer(
-    VkDevice device, VkPhysicalDevice physicalDevice,
-    VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-    VkBuffer* buffer, VkDeviceMemory* bufferMemory
-) {
-    VkBufferCreateInfo bufferInfo;
-    zero(bufferInfo);
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    {
-        VkResult result = vkCreateBuffer(device, &bufferInfo, 0, buffer);
-        assert(result == VK_SUCCESS);
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, *buffer, &memRequirements);
+initIndirectDrawBuffer(IndirectDrawBuffer* draws, DeviceHeap* heap, u32 capacity) {
+    ZeroMemory(draws, sizeof(IndirectDrawBuffer));
+    draws->capacity = capacity;
+    createMappedBuffer(
+        heap,
+        sizeof(VkDrawIndexedIndirectCommand) * capacity,
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, MemoryCategory_Geometry,
+        &draws->buffer, &draws->memory,
+        &draws->commands
+    );
+}
 
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-    i32 bufferMemIndex = findMemoryTypeIndex(physicalDevice, memRequirements.memoryTypeBits, properties);
+void
+destroyIndirectDrawBuffer(IndirectDrawBuffer* draws, DeviceHeap* heap) {
+    destroyBuffer(heap, draws->buffer, &draws->memory);
+}
 
-    VkMemoryAllocateInfo allocInfo;
-    zero(allocInfo);
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = bufferMemIndex;
+// NOTE(sen) Call once the image's previous frame is done on the GPU
+void
+beginIndirectDraws(IndirectDrawBuffer* draws) {
+    draws->count = 0;
+    draws->runFirst = 0;
+}
 
-    {
-        VkResult result = vkAllocateMemory(device, &allocInfo, 0, bufferMemory);
-        assert(result == VK_SUCCESS);
+// NOTE(sen) Submits the commands pushed since the last flush. Without the multiDrawIndirect
+// feature drawCount has to be 0 or 1, so that's one call per command.
+void
+cmdFlushIndirectDraws(VkCommandBuffer commandBuffer, IndirectDrawBuffer* draws, b32 multiDraw, u32 maxDrawCount) {
+    u32 stride = sizeof(VkDrawIndexedIndirectCommand);
+    u32 perCall = multiDraw ? maxDrawCount : 1;
+    while (draws->runFirst < draws->count) {
+        u32 drawCount = draws->count - draws->runFirst;
+        if (drawCount > perCall) {
+            drawCount = perCall;
+        }
+        vkCmdDrawIndexedIndirect(commandBuffer, draws->buffer, (VkDeviceSize)draws->runFirst * stride, drawCount, stride);
+        draws->runFirst += drawCount;
     }
-
-    assert(vkBindBufferMemory(device, *buffer, *bufferMemory, 0) == VK_SUCCESS);
 }
 
+// NOTE(sen) Adds to the current run, or draws directly when out of room. The pending run is
+// flushed before a direct draw so draws still execute in the order they were recorded.
+// Flush before changing any state the pending draws depend on.
 void
-createMappedBuffer(
-    VkDevice device,
-    VkPhysicalDevice physicalDevice,
-    VkDeviceSize dataSize,
-    VkCommandPool commandPool,
-    VkQueue queue,
-    VkBufferUsageFlags bufferUsage,
-    VkBuffer* buffer,
-    VkDeviceMemory* bufferMemory,
-    void** gpuData
+cmdDrawIndexedDeferred(
+    VkCommandBuffer commandBuffer, IndirectDrawBuffer* draws, b32 multiDraw, u32 maxDrawCount,
+    u32 indexCount, u32 instanceCount, u32 firstIndex, i32 vertexOffset, u32 firstInstance
 ) {
-
-    createBuffer(
-        device, physicalDevice, dataSize,
-        bufferUsage,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        buffer, bufferMemory
-    );
-
-    {
-        VkResult result = vkMapMemory(device, *bufferMemory, 0, dataSize, 0, gpuData);
-        assert(result == VK_SUCCESS);
+    if (draws && draws->count < draws->capacity) {
+        VkDrawIndexedIndirectCommand* command = draws->commands + draws->count++;
+        command->indexCount = indexCount;
+        command->instanceCount = instanceCount;
+        command->firstIndex = firstIndex;
+        command->vertexOffset = vertexOffset;
+        command->firstInstance = firstInstance;
+    } else {
+        if (draws) {
+            cmdFlushIndirectDraws(commandBuffer, draws, multiDraw, maxDrawCount);
+        }
+        vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
     }
 }
 
+void
+cmdPushDrawConstants(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, DrawConstants* constants) {
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), constants);
+}
+
 void
 createImage(
-    VkDevice device, VkPhysicalDevice physicalDevice,
+    DeviceHeap* heap,
     u32 width, u32 height,
     VkFormat format,
     VkImageUsageFlags usage,
     VkImageLayout initialLayout,
-    VkImage* image, VkDeviceMemory* imageMemory
+    MemoryCategory category,
+    VkImage* image, DeviceAllocation* imageMemory
 ) {
+    VkDevice device = heap->device;
 
     VkImageCreateInfo info = { 0 };
     info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -580,25 +1579,24 @@ createImage(
     info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     info.samples = VK_SAMPLE_COUNT_1_BIT;
 
-    assert(vkCreateImage(device, &info, 0, image) == VK_SUCCESS);
+    assert(vkCreateImage(device, &info, getHostCallbacks(HostScope_Device), image) == VK_SUCCESS);
 
     VkMemoryRequirements memRequirements;
     vkGetImageMemoryRequirements(device, *image, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo = { 0 };
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryTypeIndex(
-        physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-    );
+    allocDeviceMemory(heap, memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, category, imageMemory);
+    assert(vkBindImageMemory(device, *image, imageMemory->memory, imageMemory->offset) == VK_SUCCESS);
 
-    assert(vkAllocateMemory(device, &allocInfo, 0, imageMemory) == VK_SUCCESS);
-    assert(vkBindImageMemory(device, *image, *imageMemory, 0) == VK_SUCCESS);
+}
 
+void
+destroyImage(DeviceHeap* heap, VkImage image, DeviceAllocation* imageMemory) {
+    vkDestroyImage(heap->device, image, getHostCallbacks(HostScope_Device));
+    freeDeviceMemory(heap, imageMemory);
 }
 
 VkImageView
-createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect) {
+createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect, HostScope scope) {
     VkImageViewCreateInfo viewInfo = { 0 };
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -610,7 +1608,7 @@ createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFl
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
     VkImageView view;
-    assert(vkCreateImageView(device, &viewInfo, 0, &view) == VK_SUCCESS);
+    assert(vkCreateImageView(device, &viewInfo, getHostCallbacks(scope), &view) == VK_SUCCESS);
     return view;
 }
 
@@ -706,16 +1704,102 @@ cmdTransitionLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout
     );
 }
 
+void
+createQuadIndexBuffer(
+    QuadIndexBuffer* quadIndices,
+    DeviceHeap* heap,
+    VkQueue queue,
+    VkCommandPool commandPool,
+    u32 quadCapacity
+) {
+    assert(quadCapacity * 4 <= 65536);
+    ZeroMemory(quadIndices, sizeof(QuadIndexBuffer));
+    quadIndices->quadCapacity = quadCapacity;
+    VkDeviceSize size = sizeof(u16) * 6 * quadCapacity;
+
+    VkDevice device = heap->device;
+    VkBuffer stagingBuffer;
+    DeviceAllocation stagingMemory;
+    GeometryBuffer staging = { 0 };
+    staging.indexCapacity = 6 * quadCapacity;
+    createMappedBuffer(
+        heap, size,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory_Staging,
+        &stagingBuffer, &stagingMemory,
+        &staging.indexData
+    );
+    for (u32 quad = 0; quad < quadCapacity; quad++) {
+        pushQuadIndices(&staging, quad * 4);
+    }
+
+    createBuffer(
+        heap, size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory_Geometry,
+        &quadIndices->buffer, &quadIndices->memory
+    );
+
+    {
+        VkCommandBuffer commandBuffer = beginSingleTimeCommandBuffer(device, commandPool);
+        VkBufferCopy region = { 0 };
+        region.size = size;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, quadIndices->buffer, 1, &region);
+        endSingleTimeCommandBuffer(commandBuffer, device, queue, commandPool);
+    }
+
+    destroyBuffer(heap, stagingBuffer, &stagingMemory);
+}
+
+// NOTE(sen) Also called when compaction moves the transient buffer, the sets must not be in use
+void
+writeSwapChainDescriptorSets(SwapChain* swapChain, VkDevice device) {
+    for (u32 index = 0; index < swapChain->imageCount; index++) {
+        VkDescriptorBufferInfo bufferInfo;
+        zero(bufferInfo);
+        // NOTE(sen) Where the uniforms are is given at bind time as a dynamic offset
+        bufferInfo.buffer = swapChain->transient.buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(UniformBufferObject);
+
+        VkDescriptorImageInfo imageInfo = { 0 };
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = swapChain->textureImageView;
+        imageInfo.sampler = swapChain->textureSampler;
+
+        VkWriteDescriptorSet descriptorWrites[2] = { 0 };
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = swapChain->descriptorSets[index];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = swapChain->descriptorSets[index];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(device, arrayCount(descriptorWrites), descriptorWrites, 0, 0);
+    }
+}
+
 void
 initSwapChain(
     SwapChain* swapChain,
     VkSwapchainKHR oldSwapChain,
     VkPhysicalDevice physicalDevice,
     VkDevice device,
+    DeviceHeap* heap,
     VkSurfaceKHR surface,
     VkPresentModeKHR presentMode,
     VkPipelineShaderStageCreateInfo* shaderStages,
     VkPipelineVertexInputStateCreateInfo* vertexInputInfo,
+    VkPipelineShaderStageCreateInfo* quadShaderStages,
+    VkPipelineVertexInputStateCreateInfo* quadVertexInputInfo,
     VkPipelineInputAssemblyStateCreateInfo* inputAssembly,
     VkPipelineRasterizationStateCreateInfo* rasterizer,
     VkPipelineMultisampleStateCreateInfo* multisampling,
@@ -725,9 +1809,13 @@ initSwapChain(
     VkCommandPool commandPool,
     VkDescriptorSetLayout descriptorSetLayout,
     VkImageView textureImageView,
-    VkSampler textureSampler
+    VkSampler textureSampler,
+    QuadIndexBuffer* quadIndices,
+    VertexFormat vertexFormat,
+    GeometryPlacement retainedPlacement
 ) {
     ZeroMemory(swapChain, sizeof(SwapChain));
+    swapChain->heap = heap;
 
     VkSurfaceFormatKHR surfaceFormat;
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
@@ -777,11 +1865,14 @@ initSwapChain(
         createInfo.clipped = VK_TRUE;
         createInfo.oldSwapchain = oldSwapChain;
 
-        VkResult result = vkCreateSwapchainKHR(device, &createInfo, 0, &swapChain->swapChain);
+        VkResult result = vkCreateSwapchainKHR(device, &createInfo, getHostCallbacks(HostScope_SwapChain), &swapChain->swapChain);
         assert(result == VK_SUCCESS);
     }
 
     vkGetSwapchainImagesKHR(device, swapChain->swapChain, &swapChain->imageCount, 0);
+    // NOTE(sen) B8G8R8A8, 4 bytes a pixel
+    swapChain->imageBytes = (VkDeviceSize)swapChain->surfaceDim.x * (VkDeviceSize)swapChain->surfaceDim.y * 4;
+    trackDeviceMemory(heap, MemoryCategory_SwapChain, swapChain->imageBytes * swapChain->imageCount, swapChain->imageCount);
     VkImage* swapChainImages = malloc(sizeof(VkImage) * swapChain->imageCount);
     vkGetSwapchainImagesKHR(device, swapChain->swapChain, &swapChain->imageCount, swapChainImages);
     swapChain->imageViews = malloc(sizeof(VkImageView) * swapChain->imageCount);
@@ -802,7 +1893,7 @@ initSwapChain(
         createInfo.subresourceRange.baseArrayLayer = 0;
         createInfo.subresourceRange.layerCount = 1;
 
-        VkResult result = vkCreateImageView(device, &createInfo, 0, swapChain->imageViews + imageIndex);
+        VkResult result = vkCreateImageView(device, &createInfo, getHostCallbacks(HostScope_SwapChain), swapChain->imageViews + imageIndex);
         assert(result == VK_SUCCESS);
     }
     free(swapChainImages);
@@ -847,22 +1938,24 @@ initSwapChain(
     // NOTE(sen) Depth buffer
     VkFormat depthFormat = VK_FORMAT_D32_SFLOAT_S8_UINT;
     {
-        VkFormatProperties props;
-        vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &props);
+        VkFormatProperties props = getFormatProperties(heap->caps, depthFormat);
         VkFormatFeatureFlagBits features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT;
         assert((props.optimalTilingFeatures & features) == features);
     }
     VkImageLayout depthInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     createImage(
-        device, physicalDevice,
+        heap,
         (u32)swapChain->surfaceDim.x, (u32)swapChain->surfaceDim.y,
         depthFormat,
         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
         depthInitialLayout,
+        MemoryCategory_Depth,
         &swapChain->depthImage,
         &swapChain->depthImageMemory
     );
-    swapChain->depthImageView = createImageView(device, swapChain->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    swapChain->depthImageView = createImageView(
+        device, swapChain->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, HostScope_SwapChain
+    );
 
     VkImageLayout depthFinalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
     {
@@ -922,7 +2015,7 @@ initSwapChain(
         renderPassInfo.dependencyCount = 1;
         renderPassInfo.pDependencies = &dependency;
 
-        VkResult result = vkCreateRenderPass(device, &renderPassInfo, 0, &swapChain->renderPass);
+        VkResult result = vkCreateRenderPass(device, &renderPassInfo, getHostCallbacks(HostScope_SwapChain), &swapChain->renderPass);
         assert(result == VK_SUCCESS);
     }
 
@@ -954,7 +2047,12 @@ initSwapChain(
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.pDepthStencilState = &depthStencil;
 
-    assert(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, 0, &swapChain->graphicsPipeline) == VK_SUCCESS);
+    assert(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, getHostCallbacks(HostScope_Pipeline), &swapChain->graphicsPipeline) == VK_SUCCESS);
+
+    // NOTE(sen) Same state, instanced quads
+    pipelineInfo.pStages = quadShaderStages;
+    pipelineInfo.pVertexInputState = quadVertexInputInfo;
+    assert(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, getHostCallbacks(HostScope_Pipeline), &swapChain->quadPipeline) == VK_SUCCESS);
 
     swapChain->framebuffers = malloc(sizeof(VkFramebuffer) * swapChain->imageCount);
 
@@ -970,25 +2068,20 @@ initSwapChain(
         framebufferInfo.height = surfaceCapabilities.currentExtent.height;
         framebufferInfo.layers = 1;
 
-        VkResult result = vkCreateFramebuffer(device, &framebufferInfo, 0, swapChain->framebuffers + index);
+        VkResult result = vkCreateFramebuffer(device, &framebufferInfo, getHostCallbacks(HostScope_SwapChain), swapChain->framebuffers + index);
         assert(result == VK_SUCCESS);
 
     }
 
-    swapChain->uniformBuffers = malloc(sizeof(VkBuffer) * swapChain->imageCount);
-    swapChain->uniformBuffersMemory = malloc(sizeof(VkDeviceMemory) * swapChain->imageCount);
-    for (size_t index = 0; index < swapChain->imageCount; index++) {
-        createBuffer(
-            device, physicalDevice,
-            sizeof(UniformBufferObject),
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            swapChain->uniformBuffers + index, swapChain->uniformBuffersMemory + index
-        );
-    }
+    // NOTE(sen) A segment holds a whole retained buffer's staging so a full rewrite always fits
+    initTransientBuffer(
+        &swapChain->transient, heap,
+        getVertexSize(vertexFormat) * RETAINED_RECT_CAPACITY * 4 + TRANSIENT_SEGMENT_SIZE,
+        swapChain->imageCount
+    );
 
     VkDescriptorPoolSize poolSizes[2] = { 0 };
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     poolSizes[0].descriptorCount = swapChain->imageCount;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = swapChain->imageCount;
@@ -999,7 +2092,7 @@ initSwapChain(
     poolInfo.pPoolSizes = poolSizes;
     poolInfo.maxSets = swapChain->imageCount;
 
-    assert(vkCreateDescriptorPool(device, &poolInfo, 0, &swapChain->descriptorPool) == VK_SUCCESS);
+    assert(vkCreateDescriptorPool(device, &poolInfo, getHostCallbacks(HostScope_SwapChain), &swapChain->descriptorPool) == VK_SUCCESS);
 
     {
         swapChain->layouts = malloc(sizeof(VkDescriptorSetLayout) * swapChain->imageCount);
@@ -1016,37 +2109,9 @@ initSwapChain(
         assert(vkAllocateDescriptorSets(device, &allocInfo, swapChain->descriptorSets) == VK_SUCCESS);
     }
 
-    for (u32 index = 0; index < swapChain->imageCount; index++) {
-        VkDescriptorBufferInfo bufferInfo;
-        zero(bufferInfo);
-        bufferInfo.buffer = swapChain->uniformBuffers[index];
-        bufferInfo.offset = 0;
-        bufferInfo.range = sizeof(UniformBufferObject);
-
-        VkDescriptorImageInfo imageInfo = { 0 };
-        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfo.imageView = textureImageView;
-        imageInfo.sampler = textureSampler;
-
-        VkWriteDescriptorSet descriptorWrites[2] = { 0 };
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = swapChain->descriptorSets[index];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = swapChain->descriptorSets[index];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pImageInfo = &imageInfo;
-
-        vkUpdateDescriptorSets(device, arrayCount(descriptorWrites), descriptorWrites, 0, 0);
-    }
+    swapChain->textureImageView = textureImageView;
+    swapChain->textureSampler = textureSampler;
+    writeSwapChainDescriptorSets(swapChain, device);
 
     swapChain->commandBuffers = malloc(sizeof(VkCommandBuffer) * swapChain->imageCount);
     VkCommandBufferAllocateInfo allocInfo = { 0 };
@@ -1056,35 +2121,32 @@ initSwapChain(
     allocInfo.commandBufferCount = swapChain->imageCount;
     assert(vkAllocateCommandBuffers(device, &allocInfo, swapChain->commandBuffers) == VK_SUCCESS);
 
-    swapChain->vertexIndexBuffer = malloc(sizeof(VertexIndexBuffer) * swapChain->imageCount);
-
+    swapChain->geometryStreams = malloc(sizeof(GeometryStream) * swapChain->imageCount);
     for (u32 index = 0; index < swapChain->imageCount; index++) {
+        initGeometryStream(
+            swapChain->geometryStreams + index, heap,
+            quadIndices, vertexFormat, GEOMETRY_BLOCK_VERTICES
+        );
+    }
 
-        VertexIndexBuffer* buf = swapChain->vertexIndexBuffer + index;
-
-        buf->curIndex = 0;
-        buf->curVertex = 0;
+    swapChain->quadInstanceStreams = malloc(sizeof(QuadInstanceStream) * swapChain->imageCount);
+    for (u32 index = 0; index < swapChain->imageCount; index++) {
+        initQuadInstanceStream(swapChain->quadInstanceStreams + index, heap, QUAD_INSTANCE_STREAM_CAPACITY);
+    }
 
-        createMappedBuffer(
-            device, physicalDevice,
-            sizeof(Vertex) * 1000,
-            commandPool,
-            graphicsQueue,
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-            &buf->vertexBuffer, &buf->vertexMemory,
-            &buf->vertexData
-        );
+    swapChain->indirectDraws = malloc(sizeof(IndirectDrawBuffer) * swapChain->imageCount);
+    for (u32 index = 0; index < swapChain->imageCount; index++) {
+        initIndirectDrawBuffer(swapChain->indirectDraws + index, heap, INDIRECT_DRAW_CAPACITY);
+    }
 
-        createMappedBuffer(
-            device, physicalDevice,
-            sizeof(u16) * 1000,
-            commandPool,
-            graphicsQueue,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            &buf->indexBuffer, &buf->indexMemory,
-            &buf->indexData
+    assert(RETAINED_RECT_CAPACITY <= quadIndices->quadCapacity);
+    swapChain->retainedPlacement = retainedPlacement;
+    swapChain->retainedGeometry = malloc(sizeof(VertexIndexBuffer) * swapChain->imageCount);
+    for (u32 index = 0; index < swapChain->imageCount; index++) {
+        createVertexIndexBuffer(
+            swapChain->retainedGeometry + index, heap,
+            vertexFormat, RETAINED_RECT_CAPACITY * 4, false, retainedPlacement
         );
-
     }
 
 }
@@ -1093,47 +2155,130 @@ void
 cleanupSwapChain(SwapChain* swapChain, VkDevice device, VkCommandPool commandPool) {
     vkDeviceWaitIdle(device);
     for (size_t index = 0; index < swapChain->imageCount; index++) {
-        vkDestroyFramebuffer(device, swapChain->framebuffers[index], 0);
+        vkDestroyFramebuffer(device, swapChain->framebuffers[index], getHostCallbacks(HostScope_SwapChain));
     }
     vkFreeCommandBuffers(device, commandPool, swapChain->imageCount, swapChain->commandBuffers);
-    vkDestroyPipeline(device, swapChain->graphicsPipeline, 0);
-    vkDestroyRenderPass(device, swapChain->renderPass, 0);
+    vkDestroyPipeline(device, swapChain->graphicsPipeline, getHostCallbacks(HostScope_Pipeline));
+    vkDestroyPipeline(device, swapChain->quadPipeline, getHostCallbacks(HostScope_Pipeline));
+    vkDestroyRenderPass(device, swapChain->renderPass, getHostCallbacks(HostScope_SwapChain));
     for (size_t index = 0; index < swapChain->imageCount; index++) {
-        vkDestroyImageView(device, swapChain->imageViews[index], 0);
-        vkDestroyBuffer(device, swapChain->uniformBuffers[index], 0);
-        vkFreeMemory(device, swapChain->uniformBuffersMemory[index], 0);
+        vkDestroyImageView(device, swapChain->imageViews[index], getHostCallbacks(HostScope_SwapChain));
     }
-    vkDestroySwapchainKHR(device, swapChain->swapChain, 0);
-    vkDestroyDescriptorPool(device, swapChain->descriptorPool, 0);
+    vkDestroySwapchainKHR(device, swapChain->swapChain, getHostCallbacks(HostScope_SwapChain));
+    trackDeviceMemory(
+        swapChain->heap, MemoryCategory_SwapChain,
+        -(i64)(swapChain->imageBytes * swapChain->imageCount), -(i32)swapChain->imageCount
+    );
+    vkDestroyDescriptorPool(device, swapChain->descriptorPool, getHostCallbacks(HostScope_SwapChain));
     free(swapChain->imageViews);
     free(swapChain->framebuffers);
     free(swapChain->commandBuffers);
-    free(swapChain->uniformBuffers);
-    free(swapChain->uniformBuffersMemory);
     free(swapChain->layouts);
     free(swapChain->descriptorSets);
 
     for (size_t index = 0; index < swapChain->imageCount; index++) {
+        destroyGeometryStream(swapChain->geometryStreams + index);
+    }
+    free(swapChain->geometryStreams);
+
+    for (size_t index = 0; index < swapChain->imageCount; index++) {
+        destroyQuadInstanceStream(swapChain->quadInstanceStreams + index);
+    }
+    free(swapChain->quadInstanceStreams);
+
+    for (size_t index = 0; index < swapChain->imageCount; index++) {
+        destroyVertexIndexBuffer(swapChain->retainedGeometry + index, swapChain->heap);
+    }
+    free(swapChain->retainedGeometry);
+    destroyTransientBuffer(&swapChain->transient, swapChain->heap);
+
+    for (size_t index = 0; index < swapChain->imageCount; index++) {
+        destroyIndirectDrawBuffer(swapChain->indirectDraws + index, swapChain->heap);
+    }
+    free(swapChain->indirectDraws);
+
+    vkDestroyImageView(device, swapChain->depthImageView, getHostCallbacks(HostScope_SwapChain));
+    destroyImage(swapChain->heap, swapChain->depthImage, &swapChain->depthImageMemory);
+
+}
 
-        VertexIndexBuffer* buf = swapChain->vertexIndexBuffer + index;
+// NOTE(sen) The new buffers start empty, the caller has to mark every retained rect dirty
+void
+setRetainedPlacement(SwapChain* swapChain, GeometryPlacement placement) {
+    vkDeviceWaitIdle(swapChain->heap->device);
+    VertexFormat format = swapChain->retainedGeometry[0].geometry.format;
+    for (u32 index = 0; index < swapChain->imageCount; index++) {
+        destroyVertexIndexBuffer(swapChain->retainedGeometry + index, swapChain->heap);
+        createVertexIndexBuffer(
+            swapChain->retainedGeometry + index, swapChain->heap,
+            format, RETAINED_RECT_CAPACITY * 4, false, placement
+        );
+    }
+    swapChain->retainedPlacement = placement;
+}
 
-        vkUnmapMemory(device, buf->indexMemory);
-        vkUnmapMemory(device, buf->vertexMemory);
+// NOTE(sen) Everything in the heap that isn't pinned belongs to the swapchain or is the quad
+// index buffer, so this is the one place that knows every owner
+void
+relocateSwapChainBuffers(SwapChain* swapChain, QuadIndexBuffer* quadIndices, VkCommandBuffer commandBuffer) {
+    DeviceHeap* heap = swapChain->heap;
+    relocateBuffer(heap, commandBuffer, &quadIndices->buffer, &quadIndices->memory);
+    for (u32 index = 0; index < swapChain->imageCount; index++) {
+        relocateVertexIndexBuffer(swapChain->retainedGeometry + index, heap, commandBuffer);
 
-        vkFreeMemory(device, buf->indexMemory, 0);
-        vkFreeMemory(device, buf->vertexMemory, 0);
+        GeometryStream* stream = swapChain->geometryStreams + index;
+        for (u32 block = 0; block < stream->blockCount; block++) {
+            relocateVertexIndexBuffer(stream->blocks + block, heap, commandBuffer);
+        }
 
-        vkDestroyBuffer(device, buf->vertexBuffer, 0);
-        vkDestroyBuffer(device, buf->indexBuffer, 0);
+        QuadInstanceStream* instances = swapChain->quadInstanceStreams + index;
+        if (relocateBuffer(heap, commandBuffer, &instances->buffer, &instances->memory)) {
+            instances->instances.data = instances->memory.mapped;
+        }
 
+        IndirectDrawBuffer* draws = swapChain->indirectDraws + index;
+        if (relocateBuffer(heap, commandBuffer, &draws->buffer, &draws->memory)) {
+            draws->commands = draws->memory.mapped;
+        }
     }
 
-    free(swapChain->vertexIndexBuffer);
+    TransientBuffer* transient = &swapChain->transient;
+    if (relocateBuffer(heap, commandBuffer, &transient->buffer, &transient->memory)) {
+        transient->data = transient->memory.mapped;
+        writeSwapChainDescriptorSets(swapChain, heap->device);
+    }
+}
 
-    vkDestroyImageView(device, swapChain->depthImageView, 0);
-    vkFreeMemory(device, swapChain->depthImageMemory, 0);
-    vkDestroyImage(device, swapChain->depthImage, 0);
+// NOTE(sen) Waits for the device, only worth it when nothing is being drawn or when asked for.
+// Returns false when no block was worth emptying.
+b32
+compactDeviceMemory(
+    SwapChain* swapChain, QuadIndexBuffer* quadIndices, VkQueue queue, VkCommandPool commandPool, b32 force
+) {
+    DeviceHeap* heap = swapChain->heap;
+    HeapFragmentation before = getHeapFragmentation(heap);
+    if (!force && getFragmentationRatio(&before) < HEAP_COMPACTION_THRESHOLD) {
+        return false;
+    }
+    vkDeviceWaitIdle(heap->device);
+    u32 marked = beginHeapCompaction(heap);
+    if (marked == 0) {
+        return false;
+    }
 
+    VkCommandBuffer commandBuffer = beginSingleTimeCommandBuffer(heap->device, commandPool);
+    relocateSwapChainBuffers(swapChain, quadIndices, commandBuffer);
+    endSingleTimeCommandBuffer(commandBuffer, heap->device, queue, commandPool);
+    u32 released = endHeapCompaction(heap);
+
+    HeapFragmentation after = getHeapFragmentation(heap);
+    char report[512];
+    u32 length = snprintf(report, sizeof(report), "compaction: %u of %u blocks released\nbefore: ", released, marked);
+    length += formatHeapFragmentation(&before, report + length, sizeof(report) - length);
+    length += snprintf(report + length, sizeof(report) - length, "after: ");
+    formatHeapFragmentation(&after, report + length, sizeof(report) - length);
+    OutputDebugString(report);
+    return true;
 }
 
 int WINAPI
@@ -1179,7 +2324,12 @@ WinMain(
     //
     //
 
+    for (u32 scope = 0; scope < HostScope_Count; scope++) {
+        initHostAllocator(globalHostAllocators + scope, scope);
+    }
+
     VkInstance vulkanInstance;
+    b32 instanceProperties2 = false;
     {
         VkApplicationInfo appInfo;
         ZeroMemory(&appInfo, sizeof(VkApplicationInfo));
@@ -1194,17 +2344,28 @@ WinMain(
         ZeroMemory(&createInfo, sizeof(VkInstanceCreateInfo));
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         createInfo.pApplicationInfo = &appInfo;
-        createInfo.enabledExtensionCount = 2;
-        char* extensionNames[2];
+        char* extensionNames[3];
         extensionNames[0] = VK_KHR_SURFACE_EXTENSION_NAME;
         extensionNames[1] = VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+        createInfo.enabledExtensionCount = 2;
+
+        // NOTE(sen) Needed to query the memory budget, optional
+        u32 availableCount = 0;
+        vkEnumerateInstanceExtensionProperties(0, &availableCount, 0);
+        VkExtensionProperties* available = malloc(sizeof(VkExtensionProperties) * availableCount);
+        vkEnumerateInstanceExtensionProperties(0, &availableCount, available);
+        if (hasExtension(available, availableCount, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)) {
+            extensionNames[createInfo.enabledExtensionCount++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+            instanceProperties2 = true;
+        }
+        free(available);
         createInfo.ppEnabledExtensionNames = extensionNames;
         createInfo.enabledLayerCount = 1;
         char* layerNames[1];
         layerNames[0] = "VK_LAYER_KHRONOS_validation";
         createInfo.ppEnabledLayerNames = layerNames;
 
-        VkResult result = vkCreateInstance(&createInfo, 0, &vulkanInstance);
+        VkResult result = vkCreateInstance(&createInfo, getHostCallbacks(HostScope_Instance), &vulkanInstance);
         assert(result == VK_SUCCESS);
     }
 
@@ -1215,41 +2376,25 @@ WinMain(
         createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
         createInfo.hwnd = window;
         createInfo.hinstance = hInstance;
-        VkResult result = vkCreateWin32SurfaceKHR(vulkanInstance, &createInfo, 0, &surface);
+        VkResult result = vkCreateWin32SurfaceKHR(vulkanInstance, &createInfo, getHostCallbacks(HostScope_Instance), &surface);
         assert(result == VK_SUCCESS);
     }
 
     VkPhysicalDevice physicalDevice;
+    DeviceCaps deviceCaps;
     u32 graphicsQueueFamilyIndex = 0;
     VkPresentModeKHR presentMode;
     {
         uint32_t deviceCount = 1;
         VkResult enum_devices_result = vkEnumeratePhysicalDevices(vulkanInstance, &deviceCount, &physicalDevice);
-        VkPhysicalDeviceProperties deviceProperties;
-        vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
-        uint32_t queueFamilyCount = 1;
-        VkQueueFamilyProperties queueFamilyProperties;
-        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, &queueFamilyProperties);
-        assert(queueFamilyProperties.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        initDeviceCaps(&deviceCaps, vulkanInstance, physicalDevice, instanceProperties2);
+        assert(deviceCaps.queueFamilyCount > graphicsQueueFamilyIndex);
+        assert(deviceCaps.queueFamilies[graphicsQueueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT);
         b32 presentSupport = false;
         vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, graphicsQueueFamilyIndex, surface, &presentSupport);
         assert(presentSupport);
 
-        b32 swapChainSupported = false;
-        u32 extensionCount;
-        vkEnumerateDeviceExtensionProperties(physicalDevice, 0, &extensionCount, 0);
-        VkExtensionProperties* extensions = malloc(extensionCount * sizeof(VkExtensionProperties));
-        for (u32 extensionIndex = 0; extensionIndex < extensionCount; ++extensionIndex) {
-            VkExtensionProperties* extension = extensions + extensionIndex;
-            if (strcmp(extension->extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
-                swapChainSupported = true;
-                break;
-            }
-        }
-        assert(swapChainSupported);
-        free(extensions);
+        assert(hasExtension(deviceCaps.extensions, deviceCaps.extensionCount, VK_KHR_SWAPCHAIN_EXTENSION_NAME));
 
         u32 presentModeCount = 0;
         vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, 0);
@@ -1269,6 +2414,8 @@ WinMain(
     }
 
     VkDevice device;
+    b32 multiDrawIndirect;
+    u32 maxDrawIndirectCount;
     {
         VkDeviceQueueCreateInfo queueCreateInfo = { 0 };
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -1277,24 +2424,33 @@ WinMain(
         f32 queuePriority = 1.0f;
         queueCreateInfo.pQueuePriorities = &queuePriority;
 
-        VkPhysicalDeviceFeatures deviceFeatures;
-        vkGetPhysicalDeviceFeatures(physicalDevice, &deviceFeatures);
+        VkPhysicalDeviceFeatures deviceFeatures = deviceCaps.features;
         assert(deviceFeatures.samplerAnisotropy);
 
+        // NOTE(sen) Everything supported gets enabled below, multi-draw included when there
+        multiDrawIndirect = deviceFeatures.multiDrawIndirect;
+        maxDrawIndirectCount = deviceCaps.properties.limits.maxDrawIndirectCount;
+
         VkDeviceCreateInfo createInfo = { 0 };
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.pQueueCreateInfos = &queueCreateInfo;
         createInfo.queueCreateInfoCount = 1;
         createInfo.pEnabledFeatures = &deviceFeatures;
         createInfo.enabledExtensionCount = 1;
-        char* extensions[1];
+        char* extensions[2];
         extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+        if (deviceCaps.memoryBudget) {
+            extensions[createInfo.enabledExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+        }
         createInfo.ppEnabledExtensionNames = extensions;
 
-        VkResult result = vkCreateDevice(physicalDevice, &createInfo, 0, &device);
+        VkResult result = vkCreateDevice(physicalDevice, &createInfo, getHostCallbacks(HostScope_Device), &device);
         assert(result == VK_SUCCESS);
     }
 
+    DeviceHeap deviceHeap;
+    initDeviceHeap(&deviceHeap, device, &deviceCaps);
+
     VkQueue graphicsQueue;
     vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
 
@@ -1304,9 +2460,16 @@ WinMain(
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     poolInfo.queueFamilyIndex = graphicsQueueFamilyIndex;
     poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    assert(vkCreateCommandPool(device, &poolInfo, 0, &commandPool) == VK_SUCCESS);
+    assert(vkCreateCommandPool(device, &poolInfo, getHostCallbacks(HostScope_Device), &commandPool) == VK_SUCCESS);
+
+    // NOTE(sen) Layout of the non-instanced geometry, see VertexFormat
+    VertexFormat vertexFormat = parseVertexFormat(lpCmdLine, VertexFormat_Half);
 
-    VkShaderModule vertShaderModule = createShaderModule("build/vert.spv", device);
+    char* vertShaderPath = "build/vert.spv";
+    if (vertexFormat == VertexFormat_HalfNoColor) {
+        vertShaderPath = "build/vertnocolor.spv";
+    }
+    VkShaderModule vertShaderModule = createShaderModule(vertShaderPath, device);
     VkShaderModule fragShaderModule = createShaderModule("build/frag.spv", device);
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo;
@@ -1326,45 +2489,51 @@ WinMain(
     VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
     VkVertexInputBindingDescription bindingDescription;
-    zero(bindingDescription);
-    bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkVertexInputAttributeDescription posDescription;
-    zero(posDescription);
-    posDescription.binding = 0;
-    posDescription.location = 0;
-    posDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-    posDescription.offset = offsetof(Vertex, pos);
-
-    VkVertexInputAttributeDescription colDescription;
-    zero(colDescription);
-    colDescription.binding = 0;
-    colDescription.location = 1;
-    colDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-    colDescription.offset = offsetof(Vertex, color);
-
-    VkVertexInputAttributeDescription texDescription = { 0 };
-    texDescription.binding = 0;
-    texDescription.location = 2;
-    texDescription.format = VK_FORMAT_R32G32_SFLOAT;
-    texDescription.offset = offsetof(Vertex, texture);
-
-    VkVertexInputAttributeDescription attDescriptions[] = {
-        posDescription,
-        colDescription,
-        texDescription
-    };
+    VkVertexInputAttributeDescription attDescriptions[3];
+    u32 attDescriptionCount = getVertexInputDescription(vertexFormat, &bindingDescription, attDescriptions);
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo;
     zero(vertexInputInfo);
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = arrayCount(attDescriptions);
+    vertexInputInfo.vertexAttributeDescriptionCount = attDescriptionCount;
     vertexInputInfo.pVertexAttributeDescriptions = attDescriptions;
 
+    // NOTE(sen) Instanced quads, one QuadInstance per instance and no per-vertex data
+    VkShaderModule quadVertShaderModule = createShaderModule("build/quadvert.spv", device);
+
+    VkPipelineShaderStageCreateInfo quadVertShaderStageInfo = vertShaderStageInfo;
+    quadVertShaderStageInfo.module = quadVertShaderModule;
+
+    VkPipelineShaderStageCreateInfo quadShaderStages[] = { quadVertShaderStageInfo, fragShaderStageInfo };
+
+    VkVertexInputBindingDescription quadBindingDescription = { 0 };
+    quadBindingDescription.binding = 0;
+    quadBindingDescription.stride = sizeof(QuadInstance);
+    quadBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    VkVertexInputAttributeDescription quadAttDescriptions[4] = { 0 };
+    quadAttDescriptions[0].location = 0;
+    quadAttDescriptions[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    quadAttDescriptions[0].offset = offsetof(QuadInstance, topleft);
+    quadAttDescriptions[1].location = 1;
+    quadAttDescriptions[1].format = VK_FORMAT_R32_SFLOAT;
+    quadAttDescriptions[1].offset = offsetof(QuadInstance, depth);
+    quadAttDescriptions[2].location = 2;
+    quadAttDescriptions[2].format = VK_FORMAT_R8G8B8A8_UNORM;
+    quadAttDescriptions[2].offset = offsetof(QuadInstance, color);
+    quadAttDescriptions[3].location = 3;
+    quadAttDescriptions[3].format = VK_FORMAT_R16G16B16A16_UNORM;
+    quadAttDescriptions[3].offset = offsetof(QuadInstance, texRect);
+
+    VkPipelineVertexInputStateCreateInfo quadVertexInputInfo = { 0 };
+    quadVertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    quadVertexInputInfo.vertexBindingDescriptionCount = 1;
+    quadVertexInputInfo.pVertexBindingDescriptions = &quadBindingDescription;
+    quadVertexInputInfo.vertexAttributeDescriptionCount = arrayCount(quadAttDescriptions);
+    quadVertexInputInfo.pVertexAttributeDescriptions = quadAttDescriptions;
+
     u32 textureWidth = 2;
     u32 textureHeight = 2;
     u32 textureSize = textureWidth * textureHeight * sizeof(u32);
@@ -1375,30 +2544,33 @@ WinMain(
     texture[3] = 0xFF000000;
 
     VkBuffer textureStagingBuffer;
-    VkDeviceMemory textureStagingBufferMemory;
-    createBuffer(
-        device, physicalDevice,
+    DeviceAllocation textureStagingBufferMemory;
+    void* textureGpuData;
+    createMappedBuffer(
+        &deviceHeap,
         textureSize,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        &textureStagingBuffer, &textureStagingBufferMemory
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory_Staging,
+        &textureStagingBuffer, &textureStagingBufferMemory,
+        &textureGpuData
     );
-    void* textureGpuData;
-    vkMapMemory(device, textureStagingBufferMemory, 0, textureSize, 0, &textureGpuData);
     memcpy(textureGpuData, texture, textureSize);
-    vkUnmapMemory(device, textureStagingBufferMemory);
 
 
     VkImage textureImage;
-    VkDeviceMemory textureImageMemory;
+    DeviceAllocation textureImageMemory;
     VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
     VkImageLayout textureInitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    {
+        VkFormatProperties props = getFormatProperties(&deviceCaps, textureFormat);
+        assert(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+    }
     createImage(
-        device, physicalDevice,
+        &deviceHeap,
         textureWidth, textureHeight,
         textureFormat,
         VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
         textureInitialLayout,
+        MemoryCategory_Textures,
         &textureImage, &textureImageMemory
     );
 
@@ -1441,8 +2613,11 @@ WinMain(
 
         endSingleTimeCommandBuffer(commandBuffer, device, graphicsQueue, commandPool);
     }
+    destroyBuffer(&deviceHeap, textureStagingBuffer, &textureStagingBufferMemory);
 
-    VkImageView textureImageView = createImageView(device, textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+    VkImageView textureImageView = createImageView(
+        device, textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, HostScope_Device
+    );
 
     VkSamplerCreateInfo samplerInfo = { 0 };
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -1452,11 +2627,7 @@ WinMain(
     samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     samplerInfo.anisotropyEnable = VK_FALSE;
-    {
-        VkPhysicalDeviceProperties properties = { 0 };
-        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-        samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-    }
+    samplerInfo.maxAnisotropy = deviceCaps.properties.limits.maxSamplerAnisotropy;
     samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
     samplerInfo.compareEnable = VK_FALSE;
@@ -1467,7 +2638,7 @@ WinMain(
     samplerInfo.maxLod = 0.0f;
 
     VkSampler textureSampler;
-    assert(vkCreateSampler(device, &samplerInfo, 0, &textureSampler) == VK_SUCCESS);
+    assert(vkCreateSampler(device, &samplerInfo, getHostCallbacks(HostScope_Device), &textureSampler) == VK_SUCCESS);
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly;
     zero(inputAssembly);
@@ -1526,7 +2697,7 @@ WinMain(
     VkDescriptorSetLayoutBinding uboLayoutBinding;
     zero(uboLayoutBinding);
     uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     uboLayoutBinding.descriptorCount = 1;
     uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -1542,7 +2713,11 @@ WinMain(
     layoutInfo.pBindings = bindings;
 
     VkDescriptorSetLayout descriptorSetLayout;
-    assert(vkCreateDescriptorSetLayout(device, &layoutInfo, 0, &descriptorSetLayout) == VK_SUCCESS);
+    assert(vkCreateDescriptorSetLayout(device, &layoutInfo, getHostCallbacks(HostScope_Pipeline), &descriptorSetLayout) == VK_SUCCESS);
+
+    // NOTE(sen) Passing 0 instead makes every geometry block carry its own index buffer
+    QuadIndexBuffer quadIndices;
+    createQuadIndexBuffer(&quadIndices, &deviceHeap, graphicsQueue, commandPool, QUAD_INDEX_BUFFER_QUADS);
 
     VkPipelineLayout pipelineLayout;
     {
@@ -1552,20 +2727,36 @@ WinMain(
         pipelineLayoutInfo.setLayoutCount = 1;
         pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
 
-        VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, 0, &pipelineLayout);
+        assert(sizeof(DrawConstants) <= deviceCaps.properties.limits.maxPushConstantsSize);
+        VkPushConstantRange pushConstantRange = { 0 };
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(DrawConstants);
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        VkResult result = vkCreatePipelineLayout(device, &pipelineLayoutInfo, getHostCallbacks(HostScope_Pipeline), &pipelineLayout);
         assert(result == VK_SUCCESS);
     }
 
+    // NOTE(sen) Shader modules and layouts are in already, what goes in the arenas from here on
+    // is per swapchain
+    initHostArenas(&globalHostAllocators[HostScope_Pipeline].allocator, HOST_ARENA_SIZE);
+    initHostArenas(&globalHostAllocators[HostScope_SwapChain].allocator, HOST_ARENA_SIZE);
+
     SwapChain swapChain;
     initSwapChain(
         &swapChain,
         VK_NULL_HANDLE,
         physicalDevice,
         device,
+        &deviceHeap,
         surface,
         presentMode,
         shaderStages,
         &vertexInputInfo,
+        quadShaderStages,
+        &quadVertexInputInfo,
         &inputAssembly,
         &rasterizer,
         &multisampling,
@@ -1575,7 +2766,10 @@ WinMain(
         commandPool,
         descriptorSetLayout,
         textureImageView,
-        textureSampler
+        textureSampler,
+        &quadIndices,
+        vertexFormat,
+        getStaticGeometryPlacement(&deviceCaps)
     );
 
 #define MAX_FRAMES_IN_FLIGHT 2
@@ -1591,9 +2785,9 @@ WinMain(
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     for (u32 index = 0; index < MAX_FRAMES_IN_FLIGHT; index++) {
-        assert(vkCreateSemaphore(device, &semaphoreInfo, 0, imageAvailableSemaphores + index) == VK_SUCCESS);
-        assert(vkCreateSemaphore(device, &semaphoreInfo, 0, renderFinishedSemaphores + index) == VK_SUCCESS);
-        assert(vkCreateFence(device, &fenceInfo, 0, inFlightFences + index) == VK_SUCCESS);
+        assert(vkCreateSemaphore(device, &semaphoreInfo, getHostCallbacks(HostScope_Device), imageAvailableSemaphores + index) == VK_SUCCESS);
+        assert(vkCreateSemaphore(device, &semaphoreInfo, getHostCallbacks(HostScope_Device), renderFinishedSemaphores + index) == VK_SUCCESS);
+        assert(vkCreateFence(device, &fenceInfo, getHostCallbacks(HostScope_Device), inFlightFences + index) == VK_SUCCESS);
     }
     for (u32 index = 0; index < swapChain.imageCount; ++index) {
         imagesInFlight[index] = VK_NULL_HANDLE;
@@ -1642,17 +2836,57 @@ WinMain(
 
     Rect rect2 = moveRect(rect1, 0.1f, 0.1f, -0.5f);
 
+    Transform modelTransform;
+    initTransform(&modelTransform);
+
+    Camera camera;
+    initCamera(
+        &camera,
+        v3new(0.0f, -1.0f, 1.5f), v3new(0.0f, 0.0f, 0.0f), v3new(0.0f, 0.0f, 1.0f),
+        TAU32 / 8, 0.1f, 10.0f
+    );
+
+    JobQueue jobQueue;
+    initJobQueue(&jobQueue, getProcessorCount() - 1);
+
+    RectStore rectStore;
+    initRectStore(&rectStore, RETAINED_RECT_CAPACITY, swapChain.imageCount);
+    addStoreRect(&rectStore, rect1);
+    u32 rect2Slot = addStoreRect(&rectStore, rect2);
+    RectRun* retainedRuns = malloc(sizeof(RectRun) * RETAINED_RECT_CAPACITY);
+
+    DrawList drawList;
+    initDrawList(&drawList, 64);
+    DrawBatch drawBatches[MAX_DRAW_BATCHES];
+    CullStats cullStats = { 0 };
+    ULONGLONG lastMemoryReport = GetTickCount64();
+
     b32 minimized = false;
+    DrawMode drawMode = DrawMode_Retained;
+    b32 drawIndirect = true;
+    b32 drawPushConstants = true;
 
     f32 angle = 0.0f;
     f32 xDisplacement = 0.0f;
     f32 xDirection = 1.0f;
     while (globalRunning) {
 
+        if (MEMORY_REPORT_INTERVAL_MS > 0 && GetTickCount64() - lastMemoryReport >= MEMORY_REPORT_INTERVAL_MS) {
+            char report[2048];
+            u32 length = formatMemoryReport(&deviceHeap, report, sizeof(report));
+            formatHostAllocReport(report + length, sizeof(report) - length);
+            OutputDebugString(report);
+            lastMemoryReport = GetTickCount64();
+        }
+
         //
         //
         //
 
+        // NOTE(sen) Nothing is drawn while minimized, a good time to compact
+        if (minimized) {
+            compactDeviceMemory(&swapChain, &quadIndices, graphicsQueue, commandPool, false);
+        }
         while (minimized) {
             MSG msg;
             while (GetMessageW(&msg, window, 0, 0) && minimized) {
@@ -1714,7 +2948,42 @@ WinMain(
                 case 0x4D: { // NOTE(sen) M
                     ShowWindow(window, SW_MINIMIZE);
                     minimized = true;
-                }
+                } break;
+                case 0x43: { // NOTE(sen) C reports culling since the last report
+                    char buffer[128];
+                    snprintf(
+                        buffer, sizeof(buffer), "culled %llu of %llu rects, drew %llu\n",
+                        cullStats.culled, cullStats.tested, cullStats.tested - cullStats.culled
+                    );
+                    OutputDebugString(buffer);
+                    zero(cullStats);
+                } break;
+                case 0x42: { // NOTE(sen) B reports memory use
+                    char report[2048];
+                    u32 length = formatMemoryReport(&deviceHeap, report, sizeof(report));
+                    formatHostAllocReport(report + length, sizeof(report) - length);
+                    OutputDebugString(report);
+                } break;
+                case 0x46: { // NOTE(sen) F compacts device memory now
+                    if (!compactDeviceMemory(&swapChain, &quadIndices, graphicsQueue, commandPool, true)) {
+                        OutputDebugString("compaction: no block worth emptying\n");
+                    }
+                } break;
+                case 0x44: { // NOTE(sen) D toggles indirect draws for the streamed path
+                    drawIndirect = !drawIndirect;
+                } break;
+                case 0x50: { // NOTE(sen) P switches per-draw transforms between push constants and uniforms
+                    drawPushConstants = !drawPushConstants;
+                } break;
+                case 0x49: { // NOTE(sen) I cycles through the draw modes
+                    drawMode = (drawMode + 1) % DrawMode_Count;
+                } break;
+                case 0x47: { // NOTE(sen) G moves retained geometry between host-visible and device-local memory
+                    GeometryPlacement placement = swapChain.retainedPlacement == GeometryPlacement_HostVisible
+                        ? GeometryPlacement_DeviceLocal : GeometryPlacement_HostVisible;
+                    setRetainedPlacement(&swapChain, placement);
+                    setRectStoreImageCount(&rectStore, swapChain.imageCount);
+                } break;
                 }
             } break;
             default: {
@@ -1761,16 +3030,27 @@ WinMain(
                 imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex
             );
             if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+                // NOTE(sen) A rebuild can only drop allocations (streams start small again), more
+                // afterwards means cleanupSwapChain missed something
+                u32 liveAllocations = getLiveAllocationCount(&deviceHeap);
+                u64 hostAllocationsBefore;
+                u64 arenaAllocationsBefore;
+                getHostAllocCounts(&hostAllocationsBefore, &arenaAllocationsBefore);
+                flipHostArena(&globalHostAllocators[HostScope_Pipeline].allocator);
+                flipHostArena(&globalHostAllocators[HostScope_SwapChain].allocator);
                 SwapChain oldSwapChain = swapChain;
                 initSwapChain(
                     &swapChain,
                     oldSwapChain.swapChain,
                     physicalDevice,
                     device,
+                    &deviceHeap,
                     surface,
                     presentMode,
                     shaderStages,
                     &vertexInputInfo,
+                    quadShaderStages,
+                    &quadVertexInputInfo,
                     &inputAssembly,
                     &rasterizer,
                     &multisampling,
@@ -1780,9 +3060,25 @@ WinMain(
                     commandPool,
                     descriptorSetLayout,
                     textureImageView,
-                    textureSampler
+                    textureSampler,
+                    &quadIndices,
+                    vertexFormat,
+                    swapChain.retainedPlacement
                 );
                 cleanupSwapChain(&oldSwapChain, device, commandPool);
+                assert(getLiveAllocationCount(&deviceHeap) <= liveAllocations);
+                {
+                    u64 hostAllocations;
+                    u64 arenaAllocations;
+                    getHostAllocCounts(&hostAllocations, &arenaAllocations);
+                    char buffer[128];
+                    snprintf(
+                        buffer, sizeof(buffer), "swapchain rebuild: %llu host allocations, %llu from arenas\n",
+                        hostAllocations - hostAllocationsBefore, arenaAllocations - arenaAllocationsBefore
+                    );
+                    OutputDebugString(buffer);
+                }
+                setRectStoreImageCount(&rectStore, swapChain.imageCount);
                 result = vkAcquireNextImageKHR(
                     device, swapChain.swapChain, UINT64_MAX,
                     imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex
@@ -1795,25 +3091,20 @@ WinMain(
             vkWaitForFences(device, 1, imagesInFlight + imageIndex, VK_TRUE, UINT64_MAX);
         }
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+        beginTransientSegment(&swapChain.transient, imageIndex);
 
         // NOTE(sen) Update uniform
+        u32 uniformOffset = 0;
+        UniformBufferObject ubo;
         {
-            UniformBufferObject ubo;
             zero(ubo);
-            ubo.model = m4transpose(m4mul(
-                m4mul(m4rotationZ(0), m4translation(0.0f, 0.0f, 0.0f)),
-                m4scale(1.0f, 1.0f, 1.0f)
-            ));
-            ubo.view = m4transpose(
-                m4lookat(v3new(0.0f, -1.0f, 1.5f), v3new(0.0f, 0.0f, 0.0f), v3new(0.0f, 0.0f, 1.0f))
-            );
-            ubo.proj = m4transpose(m4perspective(TAU32 / 8, swapChain.surfaceDim.x / swapChain.surfaceDim.y, 0.1f, 10.0f));
+            ubo.model = getTransformWorld(&modelTransform);
+            ubo.view = getCameraView(&camera);
+            ubo.proj = getCameraProjection(&camera, swapChain.surfaceDim);
 
-            void* data;
-            VkDeviceMemory uniformBuffermemory = swapChain.uniformBuffersMemory[imageIndex];
-            vkMapMemory(device, uniformBuffermemory, 0, sizeof(ubo), 0, &data);
-            CopyMemory(data, &ubo, sizeof(ubo));
-            vkUnmapMemory(device, uniformBuffermemory);
+            void* uniforms = allocTransientUniform(&swapChain.transient, sizeof(ubo), &uniformOffset);
+            assert(uniforms);
+            CopyMemory(uniforms, &ubo, sizeof(ubo));
 
             angle += 0.001f;
             if (angle > TAU32) {
@@ -1825,16 +3116,59 @@ WinMain(
             }
         }
 
-        // NOTE(sen) Update vertex/index buffer
-        VertexIndexBuffer* vertexIndexBuffer = swapChain.vertexIndexBuffer + imageIndex;
-
-        vertexIndexBuffer->curIndex = 0;
-        vertexIndexBuffer->curVertex = 0;
+        // NOTE(sen) Update vertex/index and instance buffers
+        GeometryStream* geometryStream = swapChain.geometryStreams + imageIndex;
+        beginGeometryStream(geometryStream);
+        QuadInstanceStream* quadInstanceStream = swapChain.quadInstanceStreams + imageIndex;
+        beginQuadInstanceStream(quadInstanceStream);
+        beginIndirectDraws(swapChain.indirectDraws + imageIndex);
 
         rect2 = moveRect(rect2, xDisplacement * 0.001f, 0, 0);
 
-        pushRect(vertexIndexBuffer, rect1);
-        pushRect(vertexIndexBuffer, rect2);
+        Rect rects[] = { rect1, rect2 };
+
+        // NOTE(sen) Streamed and instanced rects are culled, then go out in draw key order.
+        // Retained rects are drawn as they are, their slots don't change with the camera.
+        m4 modelView = m4mul(getTransformWorld(&modelTransform), getCameraView(&camera));
+        Frustum frustum = frustumFromMatrix(m4mul(modelView, getCameraProjection(&camera, swapChain.surfaceDim)));
+        u32 visibleIndices[arrayCount(rects)];
+        u32 visibleCount = cullRects(&frustum, rects, arrayCount(rects), visibleIndices, &cullStats);
+        Rect visibleRects[arrayCount(rects)];
+        gatherRects(rects, visibleIndices, visibleCount, visibleRects);
+
+        drawList.count = 0;
+        pushRectDrawItems(&drawList, visibleRects, visibleCount, modelView, DrawPipeline_Rect, 0);
+        sortDrawList(&drawList);
+        u32 drawBatchCount = getDrawBatches(&drawList, drawBatches, arrayCount(drawBatches));
+        Rect sortedRects[arrayCount(rects)];
+        gatherSortedRects(&drawList, visibleRects, sortedRects);
+
+        VertexIndexBuffer* retainedBuffer = swapChain.retainedGeometry + imageIndex;
+        GeometryBuffer* retainedGeometry = &retainedBuffer->geometry;
+        retainedGeometry->curVertex = 0;
+        retainedGeometry->curIndex = 0;
+        u32 retainedRunCount = 0;
+        switch (drawMode) {
+        case DrawMode_Retained: {
+            // NOTE(sen) Only rect2 moves, rect1 is never rewritten after the first flush
+            setStoreRect(&rectStore, rect2Slot, rect2);
+            RectRun* runs = retainedBuffer->placement == GeometryPlacement_DeviceLocal ? retainedRuns : 0;
+            flushRectStore(&rectStore, imageIndex, retainedGeometry, runs, &retainedRunCount);
+        } break;
+        case DrawMode_Streamed: {
+            streamRectsParallel(geometryStream, &jobQueue, sortedRects, visibleCount, m4identity(), true);
+        } break;
+        case DrawMode_Instanced: {
+            streamQuadInstances(quadInstanceStream, sortedRects, visibleCount, packRGBA8(0.0f, 0.0f, 0.0f, 1.0f));
+        } break;
+        case DrawMode_PerDraw: {
+            Rect unitQuad = rect1;
+            unitQuad.topleft = v3new(0.0f, 0.0f, 0.0f);
+            unitQuad.bottomright = v3new(1.0f, 1.0f, 0.0f);
+            streamRects(geometryStream, &unitQuad, 1, m4identity());
+        } break;
+        default: break;
+        }
 
         // NOTE(sen) Fill commands
         {
@@ -1847,6 +3181,14 @@ WinMain(
             beginInfo.pInheritanceInfo = 0;
             assert(vkBeginCommandBuffer(swapChain.commandBuffers[imageIndex], &beginInfo) == VK_SUCCESS);
 
+            if (retainedRunCount > 0) {
+                b32 uploaded = cmdUploadRectRuns(
+                    swapChain.commandBuffers[imageIndex], &swapChain.transient,
+                    retainedBuffer, retainedRuns, retainedRunCount
+                );
+                assert(uploaded);
+            }
+
             VkRenderPassBeginInfo renderPassInfo;
             zero(renderPassInfo);
             renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1869,24 +3211,156 @@ WinMain(
 
             vkCmdBindPipeline(swapChain.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, swapChain.graphicsPipeline);
 
-            VkBuffer vertexBuffers[] = { vertexIndexBuffer->vertexBuffer };
-            VkDeviceSize offsets[] = { 0 };
-
-            vkCmdBindVertexBuffers(swapChain.commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
-            vkCmdBindIndexBuffer(swapChain.commandBuffers[imageIndex], vertexIndexBuffer->indexBuffer, 0, VK_INDEX_TYPE_UINT16);
             vkCmdBindDescriptorSets(
                 swapChain.commandBuffers[imageIndex],
                 VK_PIPELINE_BIND_POINT_GRAPHICS,
-                pipelineLayout, 0, 1, swapChain.descriptorSets + imageIndex, 0, 0
+                pipelineLayout, 0, 1, swapChain.descriptorSets + imageIndex, 1, &uniformOffset
             );
+            DrawConstants defaultConstants = getDefaultDrawConstants();
+            cmdPushDrawConstants(swapChain.commandBuffers[imageIndex], pipelineLayout, &defaultConstants);
+
+            // NOTE(sen) Push constants are recorded into the command buffer. The uniform way
+            // writes a whole block per draw and rebinds the set at its offset.
+            if (drawMode == DrawMode_PerDraw && visibleCount > 0) {
+                VkBuffer vertexBuffers[] = { geometryStream->blocks[0].vertexBuffer };
+                VkDeviceSize offsets[] = { 0 };
+                vkCmdBindVertexBuffers(swapChain.commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
+                vkCmdBindIndexBuffer(swapChain.commandBuffers[imageIndex], quadIndices.buffer, 0, VK_INDEX_TYPE_UINT16);
+                // NOTE(sen) Each uniform draw takes an aligned block of the transient segment. Once
+                // that runs out the rest of the draws go through push constants, on top of the
+                // frame's uniforms rebound.
+                b32 pushPerDraw = drawPushConstants;
+                for (u32 index = 0; index < visibleCount; index++) {
+                    DrawConstants constants = defaultConstants;
+                    constants.model = getUnitQuadModel(sortedRects[index]);
+                    if (!pushPerDraw) {
+                        UniformBufferObject drawUniforms = ubo;
+                        drawUniforms.model = m4mul(constants.model, ubo.model);
+                        u32 drawOffset = 0;
+                        void* uniforms = allocTransientUniform(&swapChain.transient, sizeof(drawUniforms), &drawOffset);
+                        if (uniforms) {
+                            CopyMemory(uniforms, &drawUniforms, sizeof(drawUniforms));
+                        } else {
+                            pushPerDraw = true;
+                            drawOffset = uniformOffset;
+                        }
+                        vkCmdBindDescriptorSets(
+                            swapChain.commandBuffers[imageIndex],
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            pipelineLayout, 0, 1, swapChain.descriptorSets + imageIndex, 1, &drawOffset
+                        );
+                    }
+                    if (pushPerDraw) {
+                        cmdPushDrawConstants(swapChain.commandBuffers[imageIndex], pipelineLayout, &constants);
+                    }
+                    vkCmdDrawIndexed(swapChain.commandBuffers[imageIndex], 6, 1, 0, 0, 0);
+                }
+                if (pushPerDraw) {
+                    cmdPushDrawConstants(swapChain.commandBuffers[imageIndex], pipelineLayout, &defaultConstants);
+                } else {
+                    vkCmdBindDescriptorSets(
+                        swapChain.commandBuffers[imageIndex],
+                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        pipelineLayout, 0, 1, swapChain.descriptorSets + imageIndex, 1, &uniformOffset
+                    );
+                }
+            }
+
+            // NOTE(sen) Streamed rects are in batch order, a batch can straddle blocks
+            // NOTE(sen) Indirect draws go out a run at a time, flushed whenever bindings change
+            if (drawMode == DrawMode_Streamed) {
+                VkPipeline pipelines[DrawPipeline_Count] = { swapChain.graphicsPipeline };
+                IndirectDrawBuffer* indirectDraws = drawIndirect ? swapChain.indirectDraws + imageIndex : 0;
+                u32 boundPipeline = DrawPipeline_Rect;
+                u32 blockIndex = 0;
+                u32 blockRect = 0;
+                b32 blockBound = false;
+                for (u32 batchIndex = 0; batchIndex < drawBatchCount; batchIndex++) {
+                    DrawBatch* batch = drawBatches + batchIndex;
+                    if (batch->pipeline != boundPipeline) {
+                        if (indirectDraws) {
+                            cmdFlushIndirectDraws(swapChain.commandBuffers[imageIndex], indirectDraws, multiDrawIndirect, maxDrawIndirectCount);
+                        }
+                        vkCmdBindPipeline(swapChain.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[batch->pipeline]);
+                        boundPipeline = batch->pipeline;
+                    }
+                    // NOTE(sen) Only the one texture so far, its descriptor set is bound above
+                    assert(batch->texture == 0);
+
+                    u32 remaining = batch->count;
+                    while (remaining > 0) {
+                        VertexIndexBuffer* vertexIndexBuffer = geometryStream->blocks + blockIndex;
+                        u32 blockRects = vertexIndexBuffer->geometry.curIndex / 6;
+                        if (blockRect == blockRects) {
+                            blockIndex++;
+                            blockRect = 0;
+                            blockBound = false;
+                            continue;
+                        }
+
+                        if (!blockBound) {
+                            if (indirectDraws) {
+                                cmdFlushIndirectDraws(swapChain.commandBuffers[imageIndex], indirectDraws, multiDrawIndirect, maxDrawIndirectCount);
+                            }
+                            VkBuffer vertexBuffers[] = { vertexIndexBuffer->vertexBuffer };
+                            VkDeviceSize offsets[] = { 0 };
+                            VkBuffer indexBuffer = vertexIndexBuffer->indexBuffer;
+                            VkIndexType indexType = vertexIndexBuffer->geometry.index32 ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+                            if (geometryStream->quadIndices) {
+                                indexBuffer = geometryStream->quadIndices->buffer;
+                            }
+                            vkCmdBindVertexBuffers(swapChain.commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
+                            vkCmdBindIndexBuffer(swapChain.commandBuffers[imageIndex], indexBuffer, 0, indexType);
+                            blockBound = true;
+                        }
+
+                        u32 rectCount = blockRects - blockRect;
+                        if (rectCount > remaining) {
+                            rectCount = remaining;
+                        }
+                        cmdDrawIndexedDeferred(
+                            swapChain.commandBuffers[imageIndex], indirectDraws, multiDrawIndirect, maxDrawIndirectCount,
+                            rectCount * 6, 1, blockRect * 6, 0, 0
+                        );
+                        blockRect += rectCount;
+                        remaining -= rectCount;
+                    }
+                }
+                if (indirectDraws) {
+                    cmdFlushIndirectDraws(swapChain.commandBuffers[imageIndex], indirectDraws, multiDrawIndirect, maxDrawIndirectCount);
+                }
+                if (boundPipeline != DrawPipeline_Rect) {
+                    vkCmdBindPipeline(swapChain.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, swapChain.graphicsPipeline);
+                }
+            }
+
+            if (retainedGeometry->curIndex > 0) {
+                VkBuffer vertexBuffers[] = { swapChain.retainedGeometry[imageIndex].vertexBuffer };
+                VkDeviceSize offsets[] = { 0 };
+                vkCmdBindVertexBuffers(swapChain.commandBuffers[imageIndex], 0, 1, vertexBuffers, offsets);
+                vkCmdBindIndexBuffer(swapChain.commandBuffers[imageIndex], quadIndices.buffer, 0, VK_INDEX_TYPE_UINT16);
+                vkCmdDrawIndexed(swapChain.commandBuffers[imageIndex], retainedGeometry->curIndex, 1, 0, 0, 0);
+            }
 
-            vkCmdDrawIndexed(swapChain.commandBuffers[imageIndex], vertexIndexBuffer->curIndex, 1, 0, 0, 0);
+            if (quadInstanceStream->instances.count > 0) {
+                vkCmdBindPipeline(swapChain.commandBuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, swapChain.quadPipeline);
+
+                VkBuffer instanceBuffers[] = { quadInstanceStream->buffer };
+                VkDeviceSize offsets[] = { 0 };
+                vkCmdBindVertexBuffers(swapChain.commandBuffers[imageIndex], 0, 1, instanceBuffers, offsets);
+                vkCmdBindIndexBuffer(swapChain.commandBuffers[imageIndex], quadIndices.buffer, 0, VK_INDEX_TYPE_UINT16);
+
+                // NOTE(sen) First quad's indices only, the instance picks the rect
+                vkCmdDrawIndexed(swapChain.commandBuffers[imageIndex], 6, quadInstanceStream->instances.count, 0, 0, 0);
+            }
 
             vkCmdEndRenderPass(swapChain.commandBuffers[imageIndex]);
 
             assert(vkEndCommandBuffer(swapChain.commandBuffers[imageIndex]) == VK_SUCCESS);
         }
 
+        flushTransientBuffer(&swapChain.transient, &deviceHeap);
+
         VkSubmitInfo submitInfo;
         zero(submitInfo);
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -1926,6 +3400,9 @@ WinMain(
     }
 
     vkQueueWaitIdle(graphicsQueue);
+    destroyJobQueue(&jobQueue);
+    destroyRectStore(&rectStore);
+    destroyDrawList(&drawList);
 
     return 0;
 }
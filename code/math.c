@@ -0,0 +1,955 @@
+// NOTE(sen) SIMD goes through the batch functions (m4mulBatch, m4invertBatch, sincosBatch
+// and so on), which pick SSE2 or AVX2 at runtime and match the scalar code bit for bit.
+// Single matrices stay scalar apart from m4transpose, see the notes on m4mul and m4invert.
+// SSE2 is part of the x64 baseline so it needs no check.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH_SSE2 1
+#include "immintrin.h"
+#if defined(_MSC_VER)
+#include "intrin.h"
+#else
+#include "cpuid.h"
+#endif
+#endif
+
+// NOTE(sen) The AVX2 level also covers F16C, every AVX2 CPU has it
+#if defined(__GNUC__) || defined(__clang__)
+#define MATH_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#else
+#define MATH_TARGET_AVX2
+#endif
+
+// NOTE(sen) Column-major like GLSL mat4, mN is column N / 4, row N % 4.
+// Can be copied into uniform/storage buffers as is.
+typedef struct m4 {
+    f32 m0, m1, m2, m3;
+    f32 m4, m5, m6, m7;
+    f32 m8, m9, m10, m11;
+    f32 m12, m13, m14, m15;
+} m4;
+
+typedef struct quat {
+    f32 x, y, z, w;
+} quat;
+
+typedef enum SimdLevel {
+    SimdLevel_Scalar,
+    SimdLevel_SSE2,
+    SimdLevel_AVX2,
+} SimdLevel;
+
+static SimdLevel globalSimdLevel = SimdLevel_Scalar;
+static b32 globalSimdLevelDetected = false;
+
+SimdLevel
+detectSimdLevel() {
+    SimdLevel result = SimdLevel_Scalar;
+#if MATH_SSE2
+    result = SimdLevel_SSE2;
+
+    u32 ecx1 = 0;
+    u32 ebx7 = 0;
+#if defined(_MSC_VER)
+    i32 info[4];
+    __cpuid(info, 0);
+    i32 maxLeaf = info[0];
+    __cpuid(info, 1);
+    ecx1 = info[2];
+    if (maxLeaf >= 7) {
+        __cpuidex(info, 7, 0);
+        ebx7 = info[1];
+    }
+#else
+    u32 eax, ebx, ecx, edx;
+    u32 maxLeaf = __get_cpuid_max(0, 0);
+    __cpuid(1, eax, ebx, ecx, edx);
+    ecx1 = ecx;
+    if (maxLeaf >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        ebx7 = ebx;
+    }
+#endif
+
+    // NOTE(sen) AVX registers are only usable if the OS saves them (OSXSAVE + XCR0 bits 1 and 2)
+    b32 osxsave = (ecx1 >> 27) & 1;
+    b32 avx = (ecx1 >> 28) & 1;
+    b32 f16c = (ecx1 >> 29) & 1;
+    b32 avx2 = (ebx7 >> 5) & 1;
+    if (osxsave && avx && f16c && avx2) {
+#if defined(_MSC_VER)
+        u64 xcr0 = _xgetbv(0);
+#else
+        u32 xcr0lo, xcr0hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+        u64 xcr0 = ((u64)xcr0hi << 32) | xcr0lo;
+#endif
+        if ((xcr0 & 6) == 6) {
+            result = SimdLevel_AVX2;
+        }
+    }
+#endif
+    return result;
+}
+
+SimdLevel
+getSimdLevel() {
+    if (!globalSimdLevelDetected) {
+        globalSimdLevel = detectSimdLevel();
+        globalSimdLevelDetected = true;
+    }
+    return globalSimdLevel;
+}
+
+// NOTE(sen) Lowers the level used by the batch kernels (for comparing paths),
+// can't raise it above what the CPU supports
+void
+setSimdLevel(SimdLevel level) {
+    SimdLevel supported = detectSimdLevel();
+    globalSimdLevel = level < supported ? level : supported;
+    globalSimdLevelDetected = true;
+}
+
+m4
+m4transposeScalar(m4 mat) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 0 };
+
+    result.m0 = mat.m0;
+    result.m1 = mat.m4;
+    result.m2 = mat.m8;
+    result.m3 = mat.m12;
+    result.m4 = mat.m1;
+    result.m5 = mat.m5;
+    result.m6 = mat.m9;
+    result.m7 = mat.m13;
+    result.m8 = mat.m2;
+    result.m9 = mat.m6;
+    result.m10 = mat.m10;
+    result.m11 = mat.m14;
+    result.m12 = mat.m3;
+    result.m13 = mat.m7;
+    result.m14 = mat.m11;
+    result.m15 = mat.m15;
+
+    return result;
+}
+
+m4
+m4identity() {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 1.0f, 0.0f, 0.0f, 0.0f,
+                  0.0f, 1.0f, 0.0f, 0.0f,
+                  0.0f, 0.0f, 1.0f, 0.0f,
+                  0.0f, 0.0f, 0.0f, 1.0f };
+    return result;
+}
+
+m4
+m4translation(f32 x, f32 y, f32 z) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 1.0f, 0.0f, 0.0f, 0.0f,
+                  0.0f, 1.0f, 0.0f, 0.0f,
+                  0.0f, 0.0f, 1.0f, 0.0f,
+                  x, y, z, 1.0f };
+    return result;
+}
+
+m4
+m4rotationZSinCos(f32 sinres, f32 cosres) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 1.0f, 0.0f, 0.0f, 0.0f,
+                  0.0f, 1.0f, 0.0f, 0.0f,
+                  0.0f, 0.0f, 1.0f, 0.0f,
+                  0.0f, 0.0f, 0.0f, 1.0f };
+
+    result.m0 = cosres;
+    result.m1 = sinres;
+    result.m4 = -sinres;
+    result.m5 = cosres;
+
+    return result;
+}
+
+m4
+m4rotationZ(f32 radians) {
+    return m4rotationZSinCos(sinf(radians), cosf(radians));
+}
+
+m4
+m4rotationSinCos(v3 axis, f32 sinres, f32 cosres) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 0 };
+
+    f32 x = axis.x, y = axis.y, z = axis.z;
+
+    f32 lengthSquared = x * x + y * y + z * z;
+
+    if ((lengthSquared != 1.0f) && (lengthSquared != 0.0f)) {
+        f32 ilength = 1.0f / sqrtf(lengthSquared);
+        x *= ilength;
+        y *= ilength;
+        z *= ilength;
+    }
+
+    f32 t = 1.0f - cosres;
+
+    result.m0 = x * x * t + cosres;
+    result.m1 = y * x * t + z * sinres;
+    result.m2 = z * x * t - y * sinres;
+    result.m3 = 0.0f;
+
+    result.m4 = x * y * t - z * sinres;
+    result.m5 = y * y * t + cosres;
+    result.m6 = z * y * t + x * sinres;
+    result.m7 = 0.0f;
+
+    result.m8 = x * z * t + y * sinres;
+    result.m9 = y * z * t - x * sinres;
+    result.m10 = z * z * t + cosres;
+    result.m11 = 0.0f;
+
+    result.m12 = 0.0f;
+    result.m13 = 0.0f;
+    result.m14 = 0.0f;
+    result.m15 = 1.0f;
+
+    return result;
+}
+
+m4
+m4rotation(v3 axis, f32 radians) {
+    return m4rotationSinCos(axis, sinf(radians), cosf(radians));
+}
+
+m4
+m4scale(f32 x, f32 y, f32 z) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { x, 0.0f, 0.0f, 0.0f,
+                  0.0f, y, 0.0f, 0.0f,
+                  0.0f, 0.0f, z, 0.0f,
+                  0.0f, 0.0f, 0.0f, 1.0f };
+    return result;
+}
+
+m4
+m4lookat(v3 eye, v3 target, v3 up) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 0 };
+
+    f32 length = 0.0f;
+    f32 ilength = 0.0f;
+
+    // Vector3Subtract(eye, target)
+    v3 vz = { eye.x - target.x, eye.y - target.y, eye.z - target.z };
+
+    // Vector3Normalize(vz)
+    v3 v = vz;
+    length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (length == 0.0f) length = 1.0f;
+    ilength = 1.0f / length;
+    vz.x *= ilength;
+    vz.y *= ilength;
+    vz.z *= ilength;
+
+    // Vector3CrossProduct(up, vz)
+    v3 vx = { up.y * vz.z - up.z * vz.y, up.z * vz.x - up.x * vz.z, up.x * vz.y - up.y * vz.x };
+
+    // Vector3Normalize(x)
+    v = vx;
+    length = sqrtf(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (length == 0.0f) length = 1.0f;
+    ilength = 1.0f / length;
+    vx.x *= ilength;
+    vx.y *= ilength;
+    vx.z *= ilength;
+
+    // Vector3CrossProduct(vz, vx)
+    v3 vy = { vz.y * vx.z - vz.z * vx.y, vz.z * vx.x - vz.x * vx.z, vz.x * vx.y - vz.y * vx.x };
+
+    result.m0 = vx.x;
+    result.m1 = vy.x;
+    result.m2 = vz.x;
+    result.m3 = 0.0f;
+    result.m4 = vx.y;
+    result.m5 = vy.y;
+    result.m6 = vz.y;
+    result.m7 = 0.0f;
+    result.m8 = vx.z;
+    result.m9 = vy.z;
+    result.m10 = vz.z;
+    result.m11 = 0.0f;
+    result.m12 = -(vx.x * eye.x + vx.y * eye.y + vx.z * eye.z);   // Vector3DotProduct(vx, eye)
+    result.m13 = -(vy.x * eye.x + vy.y * eye.y + vy.z * eye.z);   // Vector3DotProduct(vy, eye)
+    result.m14 = -(vz.x * eye.x + vz.y * eye.y + vz.z * eye.z);   // Vector3DotProduct(vz, eye)
+    result.m15 = 1.0f;
+
+    return result;
+}
+
+m4
+m4perspective(f32 fovYRadians, f32 aspect, f32 nearPlane, f32 farPlane) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 0 };
+
+    f32 top = nearPlane * tanf(fovYRadians * 0.5f);
+    f32 bottom = -top;
+    f32 right = top * aspect;
+    f32 left = -right;
+
+    f32 rl = right - left;
+    f32 tb = top - bottom;
+    f32 fn = farPlane - nearPlane;
+
+    result.m0 = (nearPlane * 2.0f) / rl;
+    result.m5 = (nearPlane * 2.0f) / tb;
+    result.m8 = (right + left) / rl;
+    result.m9 = (top + bottom) / tb;
+    result.m10 = -(farPlane + nearPlane) / fn;
+    result.m11 = -1.0f;
+    result.m14 = -(farPlane * nearPlane * 2.0f) / fn;
+
+    return result;
+}
+
+m4
+m4mulScalar(m4 left, m4 right) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 0 };
+
+    result.m0 = left.m0 * right.m0 + left.m1 * right.m4 + left.m2 * right.m8 + left.m3 * right.m12;
+    result.m1 = left.m0 * right.m1 + left.m1 * right.m5 + left.m2 * right.m9 + left.m3 * right.m13;
+    result.m2 = left.m0 * right.m2 + left.m1 * right.m6 + left.m2 * right.m10 + left.m3 * right.m14;
+    result.m3 = left.m0 * right.m3 + left.m1 * right.m7 + left.m2 * right.m11 + left.m3 * right.m15;
+    result.m4 = left.m4 * right.m0 + left.m5 * right.m4 + left.m6 * right.m8 + left.m7 * right.m12;
+    result.m5 = left.m4 * right.m1 + left.m5 * right.m5 + left.m6 * right.m9 + left.m7 * right.m13;
+    result.m6 = left.m4 * right.m2 + left.m5 * right.m6 + left.m6 * right.m10 + left.m7 * right.m14;
+    result.m7 = left.m4 * right.m3 + left.m5 * right.m7 + left.m6 * right.m11 + left.m7 * right.m15;
+    result.m8 = left.m8 * right.m0 + left.m9 * right.m4 + left.m10 * right.m8 + left.m11 * right.m12;
+    result.m9 = left.m8 * right.m1 + left.m9 * right.m5 + left.m10 * right.m9 + left.m11 * right.m13;
+    result.m10 = left.m8 * right.m2 + left.m9 * right.m6 + left.m10 * right.m10 + left.m11 * right.m14;
+    result.m11 = left.m8 * right.m3 + left.m9 * right.m7 + left.m10 * right.m11 + left.m11 * right.m15;
+    result.m12 = left.m12 * right.m0 + left.m13 * right.m4 + left.m14 * right.m8 + left.m15 * right.m12;
+    result.m13 = left.m12 * right.m1 + left.m13 * right.m5 + left.m14 * right.m9 + left.m15 * right.m13;
+    result.m14 = left.m12 * right.m2 + left.m13 * right.m6 + left.m14 * right.m10 + left.m15 * right.m14;
+    result.m15 = left.m12 * right.m3 + left.m13 * right.m7 + left.m14 * right.m11 + left.m15 * right.m15;
+
+    return result;
+}
+
+// NOTE(sen) Written once in terms of operation macros so the scalar and the
+// lane-parallel versions evaluate the exact same expression tree and agree
+// bit-for-bit. Element N of mat (mN) lives at index N of e.
+#define M4_INVERT_PPP(x, u, y, v, z, w) ADD(SUB(MUL(x, u), MUL(y, v)), MUL(z, w))
+#define M4_INVERT_NPN(x, u, y, v, z, w) SUB(ADD(MUL(NEG(x), u), MUL(y, v)), MUL(z, w))
+#define M4_INVERT(T, e, r) { \
+    T a00 = e[0], a01 = e[1], a02 = e[2], a03 = e[3]; \
+    T a10 = e[4], a11 = e[5], a12 = e[6], a13 = e[7]; \
+    T a20 = e[8], a21 = e[9], a22 = e[10], a23 = e[11]; \
+    T a30 = e[12], a31 = e[13], a32 = e[14], a33 = e[15]; \
+    T b00 = SUB(MUL(a00, a11), MUL(a01, a10)); \
+    T b01 = SUB(MUL(a00, a12), MUL(a02, a10)); \
+    T b02 = SUB(MUL(a00, a13), MUL(a03, a10)); \
+    T b03 = SUB(MUL(a01, a12), MUL(a02, a11)); \
+    T b04 = SUB(MUL(a01, a13), MUL(a03, a11)); \
+    T b05 = SUB(MUL(a02, a13), MUL(a03, a12)); \
+    T b06 = SUB(MUL(a20, a31), MUL(a21, a30)); \
+    T b07 = SUB(MUL(a20, a32), MUL(a22, a30)); \
+    T b08 = SUB(MUL(a20, a33), MUL(a23, a30)); \
+    T b09 = SUB(MUL(a21, a32), MUL(a22, a31)); \
+    T b10 = SUB(MUL(a21, a33), MUL(a23, a31)); \
+    T b11 = SUB(MUL(a22, a33), MUL(a23, a32)); \
+    T det = ADD(SUB(ADD(ADD(SUB(MUL(b00, b11), MUL(b01, b10)), MUL(b02, b09)), MUL(b03, b08)), MUL(b04, b07)), MUL(b05, b06)); \
+    T invDet = DIV(ONE, det); \
+    r[0] = MUL(M4_INVERT_PPP(a11, b11, a12, b10, a13, b09), invDet); \
+    r[1] = MUL(M4_INVERT_NPN(a01, b11, a02, b10, a03, b09), invDet); \
+    r[2] = MUL(M4_INVERT_PPP(a31, b05, a32, b04, a33, b03), invDet); \
+    r[3] = MUL(M4_INVERT_NPN(a21, b05, a22, b04, a23, b03), invDet); \
+    r[4] = MUL(M4_INVERT_NPN(a10, b11, a12, b08, a13, b07), invDet); \
+    r[5] = MUL(M4_INVERT_PPP(a00, b11, a02, b08, a03, b07), invDet); \
+    r[6] = MUL(M4_INVERT_NPN(a30, b05, a32, b02, a33, b01), invDet); \
+    r[7] = MUL(M4_INVERT_PPP(a20, b05, a22, b02, a23, b01), invDet); \
+    r[8] = MUL(M4_INVERT_PPP(a10, b10, a11, b08, a13, b06), invDet); \
+    r[9] = MUL(M4_INVERT_NPN(a00, b10, a01, b08, a03, b06), invDet); \
+    r[10] = MUL(M4_INVERT_PPP(a30, b04, a31, b02, a33, b00), invDet); \
+    r[11] = MUL(M4_INVERT_NPN(a20, b04, a21, b02, a23, b00), invDet); \
+    r[12] = MUL(M4_INVERT_NPN(a10, b09, a11, b07, a12, b06), invDet); \
+    r[13] = MUL(M4_INVERT_PPP(a00, b09, a01, b07, a02, b06), invDet); \
+    r[14] = MUL(M4_INVERT_NPN(a30, b03, a31, b01, a32, b00), invDet); \
+    r[15] = MUL(M4_INVERT_PPP(a20, b03, a21, b01, a22, b00), invDet); \
+}
+
+m4
+m4invertScalar(m4 mat) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    m4 result = { 0 };
+    f32* e = (f32*)&mat;
+    f32* r = (f32*)&result;
+
+#define MUL(a, b) ((a) * (b))
+#define ADD(a, b) ((a) + (b))
+#define SUB(a, b) ((a) - (b))
+#define NEG(a) (-(a))
+#define DIV(a, b) ((a) / (b))
+#define ONE 1.0f
+    M4_INVERT(f32, e, r)
+#undef MUL
+#undef ADD
+#undef SUB
+#undef NEG
+#undef DIV
+#undef ONE
+
+    return result;
+}
+
+#if MATH_SSE2
+
+// NOTE(sen) Column c of m4mul(left, right) is the sum over k of
+// left[c][k] * right column k. Terms are added in the same order as m4mulScalar,
+// without FMA, so the results are bit-identical.
+void
+m4mulSSE2(f32* result, f32* left, f32* right) {
+    __m128 r0 = _mm_loadu_ps(right + 0);
+    __m128 r1 = _mm_loadu_ps(right + 4);
+    __m128 r2 = _mm_loadu_ps(right + 8);
+    __m128 r3 = _mm_loadu_ps(right + 12);
+    for (u32 col = 0; col < 4; col++) {
+        f32* coef = left + col * 4;
+        __m128 acc = _mm_mul_ps(_mm_set1_ps(coef[0]), r0);
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(coef[1]), r1));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(coef[2]), r2));
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(coef[3]), r3));
+        _mm_storeu_ps(result + col * 4, acc);
+    }
+}
+
+MATH_TARGET_AVX2 void
+m4mulAVX2(f32* result, f32* left, f32* right) {
+    __m256 r0 = _mm256_broadcast_ps((__m128*)(right + 0));
+    __m256 r1 = _mm256_broadcast_ps((__m128*)(right + 4));
+    __m256 r2 = _mm256_broadcast_ps((__m128*)(right + 8));
+    __m256 r3 = _mm256_broadcast_ps((__m128*)(right + 12));
+    for (u32 col = 0; col < 4; col += 2) {
+        // NOTE(sen) Two result columns per register, each half broadcasting its own coefficients
+        __m256 coef = _mm256_loadu_ps(left + col * 4);
+        __m256 acc = _mm256_mul_ps(_mm256_permute_ps(coef, 0x00), r0);
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_permute_ps(coef, 0x55), r1));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_permute_ps(coef, 0xAA), r2));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_permute_ps(coef, 0xFF), r3));
+        _mm256_storeu_ps(result + col * 4, acc);
+    }
+}
+
+// NOTE(sen) Array of 4 matrices -> 16 registers, one per element, one lane per matrix
+void
+m4loadLanesSSE2(__m128* e, m4* mats) {
+    for (u32 quad = 0; quad < 4; quad++) {
+        __m128 r0 = _mm_loadu_ps((f32*)(mats + 0) + quad * 4);
+        __m128 r1 = _mm_loadu_ps((f32*)(mats + 1) + quad * 4);
+        __m128 r2 = _mm_loadu_ps((f32*)(mats + 2) + quad * 4);
+        __m128 r3 = _mm_loadu_ps((f32*)(mats + 3) + quad * 4);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        e[quad * 4 + 0] = r0;
+        e[quad * 4 + 1] = r1;
+        e[quad * 4 + 2] = r2;
+        e[quad * 4 + 3] = r3;
+    }
+}
+
+void
+m4storeLanesSSE2(m4* mats, __m128* e) {
+    for (u32 quad = 0; quad < 4; quad++) {
+        __m128 r0 = e[quad * 4 + 0];
+        __m128 r1 = e[quad * 4 + 1];
+        __m128 r2 = e[quad * 4 + 2];
+        __m128 r3 = e[quad * 4 + 3];
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps((f32*)(mats + 0) + quad * 4, r0);
+        _mm_storeu_ps((f32*)(mats + 1) + quad * 4, r1);
+        _mm_storeu_ps((f32*)(mats + 2) + quad * 4, r2);
+        _mm_storeu_ps((f32*)(mats + 3) + quad * 4, r3);
+    }
+}
+
+void
+m4invert4SSE2(m4* result, m4* mats) {
+    __m128 e[16];
+    __m128 r[16];
+    m4loadLanesSSE2(e, mats);
+    __m128 signBit = _mm_set1_ps(-0.0f);
+#define MUL(a, b) _mm_mul_ps(a, b)
+#define ADD(a, b) _mm_add_ps(a, b)
+#define SUB(a, b) _mm_sub_ps(a, b)
+#define NEG(a) _mm_xor_ps(a, signBit)
+#define DIV(a, b) _mm_div_ps(a, b)
+#define ONE _mm_set1_ps(1.0f)
+    M4_INVERT(__m128, e, r)
+#undef MUL
+#undef ADD
+#undef SUB
+#undef NEG
+#undef DIV
+#undef ONE
+    m4storeLanesSSE2(result, r);
+}
+
+MATH_TARGET_AVX2 void
+m4invert8AVX2(m4* result, m4* mats) {
+    __m128 lo[16];
+    __m128 hi[16];
+    m4loadLanesSSE2(lo, mats);
+    m4loadLanesSSE2(hi, mats + 4);
+    __m256 e[16];
+    __m256 r[16];
+    for (u32 index = 0; index < 16; index++) {
+        e[index] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[index]), hi[index], 1);
+    }
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+#define MUL(a, b) _mm256_mul_ps(a, b)
+#define ADD(a, b) _mm256_add_ps(a, b)
+#define SUB(a, b) _mm256_sub_ps(a, b)
+#define NEG(a) _mm256_xor_ps(a, signBit)
+#define DIV(a, b) _mm256_div_ps(a, b)
+#define ONE _mm256_set1_ps(1.0f)
+    M4_INVERT(__m256, e, r)
+#undef MUL
+#undef ADD
+#undef SUB
+#undef NEG
+#undef DIV
+#undef ONE
+    for (u32 index = 0; index < 16; index++) {
+        lo[index] = _mm256_castps256_ps128(r[index]);
+        hi[index] = _mm256_extractf128_ps(r[index], 1);
+    }
+    m4storeLanesSSE2(result, lo);
+    m4storeLanesSSE2(result + 4, hi);
+}
+
+#endif
+
+// NOTE(sen) Single matrices stay on the scalar path. Passing m4 by value round-trips all
+// three matrices through the stack, which costs more than the arithmetic, and the
+// compiler already vectorizes m4mulScalar - the SSE2 kernel measured ~5% slower here.
+// Use m4mulBatch when there are many products, that's where the kernels pay off.
+m4
+m4mul(m4 left, m4 right) {
+    return m4mulScalar(left, right);
+}
+
+m4
+m4transpose(m4 mat) {
+#if MATH_SSE2
+    m4 result;
+    f32* src = (f32*)&mat;
+    f32* dest = (f32*)&result;
+    __m128 r0 = _mm_loadu_ps(src + 0);
+    __m128 r1 = _mm_loadu_ps(src + 4);
+    __m128 r2 = _mm_loadu_ps(src + 8);
+    __m128 r3 = _mm_loadu_ps(src + 12);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(dest + 0, r0);
+    _mm_storeu_ps(dest + 4, r1);
+    _mm_storeu_ps(dest + 8, r2);
+    _mm_storeu_ps(dest + 12, r3);
+    return result;
+#else
+    return m4transposeScalar(mat);
+#endif
+}
+
+// NOTE(sen) The SIMD inverse keeps one element of four (eight) matrices per register so
+// it computes exactly what m4invertScalar does. With one matrix that leaves 3/4 of each
+// register empty, so there is no single-matrix SIMD path - use m4invertBatch.
+m4
+m4invert(m4 mat) {
+    return m4invertScalar(mat);
+}
+
+// NOTE(sen) result[i] = m4mul(left[i], right[i]). result may alias either input.
+void
+m4mulBatch(m4* result, m4* left, m4* right, usize count) {
+    SimdLevel level = getSimdLevel();
+    usize index = 0;
+#if MATH_SSE2
+    if (level == SimdLevel_AVX2) {
+        for (; index < count; index++) {
+            m4 product;
+            m4mulAVX2((f32*)&product, (f32*)(left + index), (f32*)(right + index));
+            result[index] = product;
+        }
+    } else if (level == SimdLevel_SSE2) {
+        for (; index < count; index++) {
+            m4 product;
+            m4mulSSE2((f32*)&product, (f32*)(left + index), (f32*)(right + index));
+            result[index] = product;
+        }
+    }
+#endif
+    for (; index < count; index++) {
+        result[index] = m4mulScalar(left[index], right[index]);
+    }
+}
+
+// NOTE(sen) result[i] = m4mul(left[i], right), e.g. many model matrices times one view-projection
+void
+m4mulBatchRight(m4* result, m4* left, m4 right, usize count) {
+    SimdLevel level = getSimdLevel();
+    usize index = 0;
+#if MATH_SSE2
+    if (level == SimdLevel_AVX2) {
+        for (; index < count; index++) {
+            m4 product;
+            m4mulAVX2((f32*)&product, (f32*)(left + index), (f32*)&right);
+            result[index] = product;
+        }
+    } else if (level == SimdLevel_SSE2) {
+        for (; index < count; index++) {
+            m4 product;
+            m4mulSSE2((f32*)&product, (f32*)(left + index), (f32*)&right);
+            result[index] = product;
+        }
+    }
+#endif
+    for (; index < count; index++) {
+        result[index] = m4mulScalar(left[index], right);
+    }
+}
+
+// NOTE(sen) Inverts 4 (SSE2) or 8 (AVX2) matrices at a time, one per lane.
+// Every lane runs the m4invertScalar expression so results are bit-identical.
+// Singular matrices produce inf/nan just like the scalar version.
+void
+m4invertBatch(m4* result, m4* mats, usize count) {
+    SimdLevel level = getSimdLevel();
+    usize index = 0;
+#if MATH_SSE2
+    if (level == SimdLevel_AVX2) {
+        for (; index + 8 <= count; index += 8) {
+            m4invert8AVX2(result + index, mats + index);
+        }
+    }
+    if (level >= SimdLevel_SSE2) {
+        for (; index + 4 <= count; index += 4) {
+            m4invert4SSE2(result + index, mats + index);
+        }
+    }
+#endif
+    for (; index < count; index++) {
+        result[index] = m4invertScalar(mats[index]);
+    }
+}
+
+// NOTE(sen) Treats point as (x, y, z, 1), drops w
+v3
+m4transformPoint(m4 mat, v3 point) {
+    v3 result;
+    result.x = mat.m0 * point.x + mat.m4 * point.y + mat.m8 * point.z + mat.m12;
+    result.y = mat.m1 * point.x + mat.m5 * point.y + mat.m9 * point.z + mat.m13;
+    result.z = mat.m2 * point.x + mat.m6 * point.y + mat.m10 * point.z + mat.m14;
+    return result;
+}
+
+quat
+quatIdentity() {
+    quat result = { 0.0f, 0.0f, 0.0f, 1.0f };
+    return result;
+}
+
+quat
+quatFromAxisAngle(v3 axis, f32 radians) {
+    // Taken from
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    quat result = { 0.0f, 0.0f, 0.0f, 1.0f };
+
+    f32 axisLength = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+    if (axisLength != 0.0f) {
+        f32 ilength = 1.0f / axisLength;
+        f32 sinres = sinf(radians * 0.5f);
+        result.x = axis.x * ilength * sinres;
+        result.y = axis.y * ilength * sinres;
+        result.z = axis.z * ilength * sinres;
+        result.w = cosf(radians * 0.5f);
+    }
+
+    return result;
+}
+
+// NOTE(sen) Translation * rotation * scale, built directly rather than with two m4mul
+m4
+m4fromTRS(v3 translation, quat rotation, v3 scale) {
+    // Rotation part taken from QuaternionToMatrix in
+    // https://github.com/raysan5/raylib/blob/master/src/raymath.h
+
+    f32 a2 = rotation.x * rotation.x;
+    f32 b2 = rotation.y * rotation.y;
+    f32 c2 = rotation.z * rotation.z;
+    f32 ac = rotation.x * rotation.z;
+    f32 ab = rotation.x * rotation.y;
+    f32 bc = rotation.y * rotation.z;
+    f32 ad = rotation.w * rotation.x;
+    f32 bd = rotation.w * rotation.y;
+    f32 cd = rotation.w * rotation.z;
+
+    m4 result = { 0 };
+
+    result.m0 = (1.0f - 2.0f * (b2 + c2)) * scale.x;
+    result.m1 = 2.0f * (ab + cd) * scale.x;
+    result.m2 = 2.0f * (ac - bd) * scale.x;
+
+    result.m4 = 2.0f * (ab - cd) * scale.y;
+    result.m5 = (1.0f - 2.0f * (a2 + c2)) * scale.y;
+    result.m6 = 2.0f * (bc + ad) * scale.y;
+
+    result.m8 = 2.0f * (ac + bd) * scale.z;
+    result.m9 = 2.0f * (bc - ad) * scale.z;
+    result.m10 = (1.0f - 2.0f * (a2 + b2)) * scale.z;
+
+    result.m12 = translation.x;
+    result.m13 = translation.y;
+    result.m14 = translation.z;
+    result.m15 = 1.0f;
+
+    return result;
+}
+
+// NOTE(sen) sincos from the Cephes library (as in sse_mathfun), the same
+// algorithm and operation order in the scalar, 4-lane and 8-lane versions so
+// they agree bit-for-bit. Over [0, TAU32) the max abs error is 8e-8 against
+// the exact result and 6e-8 against libm sinf/cosf (1 ulp just below 1.0).
+// Accuracy degrades past |x| ~ 8192.
+#define SINCOS_FOPI 1.27323954473516f
+#define SINCOS_DP1 -0.78515625f
+#define SINCOS_DP2 -2.4187564849853515625e-4f
+#define SINCOS_DP3 -3.77489497744594108e-8f
+#define SINCOS_S0 -1.9515295891e-4f
+#define SINCOS_S1 8.3321608736e-3f
+#define SINCOS_S2 -1.6666654611e-1f
+#define SINCOS_C0 2.443315711809948e-5f
+#define SINCOS_C1 -1.388731625493765e-3f
+#define SINCOS_C2 4.166664568298827e-2f
+
+void
+sincosf32(f32 radians, f32* sine, f32* cosine) {
+    u32 bits;
+    memcpy(&bits, &radians, sizeof(bits));
+    u32 sinSign = bits & 0x80000000;
+    bits &= 0x7FFFFFFF;
+    f32 x;
+    memcpy(&x, &bits, sizeof(x));
+
+    i32 j = (i32)(x * SINCOS_FOPI);
+    j = (j + 1) & ~1;
+    f32 y = (f32)j;
+    sinSign ^= (u32)(j & 4) << 29;
+    u32 cosSign = (u32)(~(j - 2) & 4) << 29;
+    b32 sinPolyForSin = (j & 2) == 0;
+
+    x = x + y * SINCOS_DP1;
+    x = x + y * SINCOS_DP2;
+    x = x + y * SINCOS_DP3;
+    f32 z = x * x;
+
+    f32 cosPoly = SINCOS_C0;
+    cosPoly = cosPoly * z + SINCOS_C1;
+    cosPoly = cosPoly * z + SINCOS_C2;
+    cosPoly = cosPoly * z;
+    cosPoly = cosPoly * z;
+    cosPoly = cosPoly - z * 0.5f;
+    cosPoly = cosPoly + 1.0f;
+
+    f32 sinPoly = SINCOS_S0;
+    sinPoly = sinPoly * z + SINCOS_S1;
+    sinPoly = sinPoly * z + SINCOS_S2;
+    sinPoly = sinPoly * z;
+    sinPoly = sinPoly * x;
+    sinPoly = sinPoly + x;
+
+    f32 sinres = sinPolyForSin ? sinPoly : cosPoly;
+    f32 cosres = sinPolyForSin ? cosPoly : sinPoly;
+
+    memcpy(&bits, &sinres, sizeof(bits));
+    bits ^= sinSign;
+    memcpy(sine, &bits, sizeof(bits));
+    memcpy(&bits, &cosres, sizeof(bits));
+    bits ^= cosSign;
+    memcpy(cosine, &bits, sizeof(bits));
+}
+
+#if MATH_SSE2
+
+void
+sincos4SSE2(__m128 x, __m128* sine, __m128* cosine) {
+    __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    __m128 sinSign = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(SINCOS_FOPI)));
+    j = _mm_add_epi32(j, _mm_set1_epi32(1));
+    j = _mm_and_si128(j, _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+    __m128i four = _mm_set1_epi32(4);
+    sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, four), 29)));
+    __m128i cosJ = _mm_sub_epi32(j, _mm_set1_epi32(2));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(cosJ, four), 29));
+    __m128 sinPolyForSin = _mm_castsi128_ps(
+        _mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128())
+    );
+
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP1)));
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP2)));
+    x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP3)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 cosPoly = _mm_set1_ps(SINCOS_C0);
+    cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(SINCOS_C1));
+    cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(SINCOS_C2));
+    cosPoly = _mm_mul_ps(cosPoly, z);
+    cosPoly = _mm_mul_ps(cosPoly, z);
+    cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.0f));
+
+    __m128 sinPoly = _mm_set1_ps(SINCOS_S0);
+    sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SINCOS_S1));
+    sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SINCOS_S2));
+    sinPoly = _mm_mul_ps(sinPoly, z);
+    sinPoly = _mm_mul_ps(sinPoly, x);
+    sinPoly = _mm_add_ps(sinPoly, x);
+
+    __m128 sinres = _mm_or_ps(_mm_and_ps(sinPolyForSin, sinPoly), _mm_andnot_ps(sinPolyForSin, cosPoly));
+    __m128 cosres = _mm_or_ps(_mm_and_ps(sinPolyForSin, cosPoly), _mm_andnot_ps(sinPolyForSin, sinPoly));
+    *sine = _mm_xor_ps(sinres, sinSign);
+    *cosine = _mm_xor_ps(cosres, cosSign);
+}
+
+MATH_TARGET_AVX2 void
+sincos8AVX2(__m256 x, __m256* sine, __m256* cosine) {
+    __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    __m256 sinSign = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+
+    __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(SINCOS_FOPI)));
+    j = _mm256_add_epi32(j, _mm256_set1_epi32(1));
+    j = _mm256_and_si256(j, _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(j);
+    __m256i four = _mm256_set1_epi32(4);
+    sinSign = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, four), 29)));
+    __m256i cosJ = _mm256_sub_epi32(j, _mm256_set1_epi32(2));
+    __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(cosJ, four), 29));
+    __m256 sinPolyForSin = _mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_setzero_si256())
+    );
+
+    x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP1)));
+    x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP2)));
+    x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP3)));
+    __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 cosPoly = _mm256_set1_ps(SINCOS_C0);
+    cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(SINCOS_C1));
+    cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(SINCOS_C2));
+    cosPoly = _mm256_mul_ps(cosPoly, z);
+    cosPoly = _mm256_mul_ps(cosPoly, z);
+    cosPoly = _mm256_sub_ps(cosPoly, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    cosPoly = _mm256_add_ps(cosPoly, _mm256_set1_ps(1.0f));
+
+    __m256 sinPoly = _mm256_set1_ps(SINCOS_S0);
+    sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(SINCOS_S1));
+    sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(SINCOS_S2));
+    sinPoly = _mm256_mul_ps(sinPoly, z);
+    sinPoly = _mm256_mul_ps(sinPoly, x);
+    sinPoly = _mm256_add_ps(sinPoly, x);
+
+    __m256 sinres = _mm256_blendv_ps(cosPoly, sinPoly, sinPolyForSin);
+    __m256 cosres = _mm256_blendv_ps(sinPoly, cosPoly, sinPolyForSin);
+    *sine = _mm256_xor_ps(sinres, sinSign);
+    *cosine = _mm256_xor_ps(cosres, cosSign);
+}
+
+// NOTE(sen) Returns how many were done, a multiple of 8
+MATH_TARGET_AVX2 usize
+sincosBatchAVX2(f32* sines, f32* cosines, f32* radians, usize count) {
+    usize index = 0;
+    for (; index + 8 <= count; index += 8) {
+        __m256 sine, cosine;
+        sincos8AVX2(_mm256_loadu_ps(radians + index), &sine, &cosine);
+        _mm256_storeu_ps(sines + index, sine);
+        _mm256_storeu_ps(cosines + index, cosine);
+    }
+    return index;
+}
+
+#endif
+
+void
+sincosBatch(f32* sines, f32* cosines, f32* radians, usize count) {
+    usize index = 0;
+#if MATH_SSE2
+    SimdLevel level = getSimdLevel();
+    if (level == SimdLevel_AVX2) {
+        index = sincosBatchAVX2(sines, cosines, radians, count);
+    }
+    if (level >= SimdLevel_SSE2) {
+        for (; index + 4 <= count; index += 4) {
+            __m128 sine, cosine;
+            sincos4SSE2(_mm_loadu_ps(radians + index), &sine, &cosine);
+            _mm_storeu_ps(sines + index, sine);
+            _mm_storeu_ps(cosines + index, cosine);
+        }
+    }
+#endif
+    for (; index < count; index++) {
+        sincosf32(radians[index], sines + index, cosines + index);
+    }
+}
+
+// NOTE(sen) Same matrices as m4rotation/m4rotationZ but with sincosBatch
+// instead of libm, so within the sincos error bound of them
+#define ROTATION_BATCH_CHUNK 64
+
+void
+m4rotationBatch(m4* result, v3* axes, f32* radians, usize count) {
+    f32 sines[ROTATION_BATCH_CHUNK];
+    f32 cosines[ROTATION_BATCH_CHUNK];
+    for (usize first = 0; first < count; first += ROTATION_BATCH_CHUNK) {
+        usize chunk = count - first < ROTATION_BATCH_CHUNK ? count - first : ROTATION_BATCH_CHUNK;
+        sincosBatch(sines, cosines, radians + first, chunk);
+        for (usize index = 0; index < chunk; index++) {
+            result[first + index] = m4rotationSinCos(axes[first + index], sines[index], cosines[index]);
+        }
+    }
+}
+
+void
+m4rotationZBatch(m4* result, f32* radians, usize count) {
+    f32 sines[ROTATION_BATCH_CHUNK];
+    f32 cosines[ROTATION_BATCH_CHUNK];
+    for (usize first = 0; first < count; first += ROTATION_BATCH_CHUNK) {
+        usize chunk = count - first < ROTATION_BATCH_CHUNK ? count - first : ROTATION_BATCH_CHUNK;
+        sincosBatch(sines, cosines, radians + first, chunk);
+        for (usize index = 0; index < chunk; index++) {
+            result[first + index] = m4rotationZSinCos(sines[index], cosines[index]);
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+// NOTE(sen) Per draw, see DrawConstants
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+    vec4 tint;
+} draw;
+
+// NOTE(sen) Per instance, see QuadInstance
+layout(location = 0) in vec4 inRect;
+layout(location = 1) in float inDepth;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec4 inTexRect;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragTint;
+
+void main() {
+    // NOTE(sen) Vertex index is the corner in pushRect order: topleft, topright, bottomleft, bottomright
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec3 position = vec3(inRect.xy + corner * inRect.zw, inDepth);
+    gl_Position = ubo.proj * ubo.view * ubo.model * draw.model * vec4(position, 1.0);
+    fragColor = inColor.rgb;
+    fragTexCoord = mix(inTexRect.xy, inTexRect.zw, corner);
+    fragTint = draw.tint;
+}
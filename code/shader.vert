@@ -6,15 +6,29 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 proj;
 } ubo;
 
+// NOTE(sen) Per draw, see DrawConstants
+layout(push_constant) uniform DrawConstants {
+    mat4 model;
+    vec4 tint;
+} draw;
+
 layout(location = 0) in vec3 inPosition;
+#ifndef NO_VERTEX_COLOR
 layout(location = 1) in vec3 inColor;
+#endif
 layout(location = 2) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec4 fragTint;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * ubo.model * draw.model * vec4(inPosition, 1.0);
+#ifdef NO_VERTEX_COLOR
+    fragColor = vec3(0.0);
+#else
     fragColor = inColor;
+#endif
     fragTexCoord = inTexCoord;
+    fragTint = draw.tint;
 }
@@ -0,0 +1,611 @@
+// NOTE(sen) Standalone correctness checks for the platform-independent code, no window or GPU.
+// Exits with the number of failed checks.
+//
+// tests [-filter name]
+
+#include "stdint.h"
+#include "stddef.h"
+#include "stdarg.h"
+
+#include "stdlib.h"
+#include "string.h"
+#include "stdio.h"
+
+#include "math.h"
+
+#include "base.c"
+#include "math.c"
+#include "jobs.c"
+#include "heap.c"
+#include "geometry.c"
+#include "hostalloc.c"
+
+typedef void TestFn(void);
+
+typedef struct Test {
+    char* name;
+    TestFn* fn;
+} Test;
+
+static u32 globalChecks = 0;
+static u32 globalFailures = 0;
+
+#define check(condition, ...) checkImpl((condition), __FILE__, __LINE__, __VA_ARGS__)
+
+void
+checkImpl(b32 condition, char* file, i32 line, char* format, ...) {
+    globalChecks++;
+    if (!condition) {
+        globalFailures++;
+        va_list args;
+        va_start(args, format);
+        fprintf(stderr, "%s:%d: ", file, line);
+        vfprintf(stderr, format, args);
+        fprintf(stderr, "\n");
+        va_end(args);
+    }
+}
+
+f32
+randomf32(u32* state, f32 min, f32 max) {
+    // NOTE(sen) xorshift32, fixed seed so failures reproduce
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return min + (f32)(x >> 8) / (f32)(1 << 24) * (max - min);
+}
+
+char*
+simdLevelName(SimdLevel level) {
+    char* result = "scalar";
+    switch (level) {
+    case SimdLevel_SSE2: result = "sse2"; break;
+    case SimdLevel_AVX2: result = "avx2"; break;
+    default: break;
+    }
+    return result;
+}
+
+// NOTE(sen) Levels the CPU can't run are reported once and skipped
+b32
+enterSimdLevel(SimdLevel level) {
+    setSimdLevel(level);
+    b32 result = getSimdLevel() == level;
+    if (!result) {
+        printf("  %s not supported, skipped\n", simdLevelName(level));
+    }
+    return result;
+}
+
+b32
+m4equal(m4 a, m4 b) {
+    return memcmp(&a, &b, sizeof(m4)) == 0;
+}
+
+//
+// NOTE(sen) Matrices, every kernel is bit-identical (0 ULP) to the scalar reference
+//
+
+// NOTE(sen) Not a multiple of 8 so the batch tails run too
+#define TEST_MATRIX_COUNT 1027
+
+void
+fillRandomMatrices(m4* mats, usize count, u32* state) {
+    for (usize index = 0; index < count; index++) {
+        f32* e = (f32*)(mats + index);
+        for (u32 element = 0; element < 16; element++) {
+            e[element] = randomf32(state, -1.0f, 1.0f);
+        }
+    }
+}
+
+void
+testM4Kernels(void) {
+    m4* left = malloc(sizeof(m4) * TEST_MATRIX_COUNT);
+    m4* right = malloc(sizeof(m4) * TEST_MATRIX_COUNT);
+    m4* out = malloc(sizeof(m4) * TEST_MATRIX_COUNT);
+    u32 state = 0x12345678;
+    fillRandomMatrices(left, TEST_MATRIX_COUNT, &state);
+    fillRandomMatrices(right, TEST_MATRIX_COUNT, &state);
+
+    for (SimdLevel level = SimdLevel_Scalar; level <= SimdLevel_AVX2; level++) {
+        if (!enterSimdLevel(level)) {
+            continue;
+        }
+        char* name = simdLevelName(level);
+
+        for (usize index = 0; index < TEST_MATRIX_COUNT; index++) {
+            m4 expected = m4mulScalar(left[index], right[index]);
+            check(m4equal(m4mul(left[index], right[index]), expected), "%s: m4mul %zu", name, index);
+            check(m4equal(m4transpose(left[index]), m4transposeScalar(left[index])), "%s: m4transpose %zu", name, index);
+            check(m4equal(m4invert(left[index]), m4invertScalar(left[index])), "%s: m4invert %zu", name, index);
+        }
+
+        m4mulBatch(out, left, right, TEST_MATRIX_COUNT);
+        for (usize index = 0; index < TEST_MATRIX_COUNT; index++) {
+            check(m4equal(out[index], m4mulScalar(left[index], right[index])), "%s: m4mulBatch %zu", name, index);
+        }
+
+        // NOTE(sen) result may alias an input
+        memcpy(out, left, sizeof(m4) * TEST_MATRIX_COUNT);
+        m4mulBatch(out, out, right, TEST_MATRIX_COUNT);
+        for (usize index = 0; index < TEST_MATRIX_COUNT; index++) {
+            check(m4equal(out[index], m4mulScalar(left[index], right[index])), "%s: m4mulBatch aliased %zu", name, index);
+        }
+
+        m4mulBatchRight(out, left, right[0], TEST_MATRIX_COUNT);
+        for (usize index = 0; index < TEST_MATRIX_COUNT; index++) {
+            check(m4equal(out[index], m4mulScalar(left[index], right[0])), "%s: m4mulBatchRight %zu", name, index);
+        }
+
+        m4invertBatch(out, left, TEST_MATRIX_COUNT);
+        for (usize index = 0; index < TEST_MATRIX_COUNT; index++) {
+            check(m4equal(out[index], m4invertScalar(left[index])), "%s: m4invertBatch %zu", name, index);
+        }
+    }
+    setSimdLevel(SimdLevel_AVX2);
+
+    free(left);
+    free(right);
+    free(out);
+}
+
+//
+// NOTE(sen) f32ToHalf gives the same bits as the F16C conversion packVerticesAVX2 uses, for
+// every f32 including NaN payloads, denormals and overflow
+//
+
+#if MATH_SSE2
+MATH_TARGET_AVX2 void
+f32ToHalf4F16C(u16* result, u32* bits) {
+    __m128i packed = _mm_cvtps_ph(_mm_castsi128_ps(_mm_loadu_si128((__m128i*)bits)), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storel_epi64((__m128i*)result, packed);
+}
+#endif
+
+void
+testF32ToHalf(void) {
+#if MATH_SSE2
+    if (!enterSimdLevel(SimdLevel_AVX2)) {
+        return;
+    }
+    u64 mismatches = 0;
+    u32 firstMismatch = 0;
+    u64 bits = 0;
+    while (bits <= 0xFFFFFFFF) {
+        u32 inputs[4];
+        u16 expected[4];
+        for (u32 lane = 0; lane < 4; lane++) {
+            inputs[lane] = (u32)(bits + lane);
+        }
+        f32ToHalf4F16C(expected, inputs);
+        for (u32 lane = 0; lane < 4; lane++) {
+            union { u32 u; f32 f; } conv;
+            conv.u = inputs[lane];
+            if (f32ToHalf(conv.f) != expected[lane]) {
+                if (mismatches == 0) {
+                    firstMismatch = inputs[lane];
+                }
+                mismatches++;
+            }
+        }
+        bits += 4;
+    }
+    check(mismatches == 0, "%llu inputs differ from F16C, first 0x%08x", (unsigned long long)mismatches, firstMismatch);
+#else
+    printf("  no F16C on this target, skipped\n");
+#endif
+}
+
+//
+// NOTE(sen) sincos, every level agrees with sincosf32 bit-for-bit and stays within the
+// bounds documented in math.c over the whole [0, TAU32) range
+//
+
+#define SINCOS_SWEEP_POINTS (1 << 24)
+#define SINCOS_SWEEP_CHUNK 4096
+#define SINCOS_MAX_ERROR_EXACT 8e-8
+#define SINCOS_MAX_ERROR_LIBM 6e-8
+
+void
+testSincosSweep(void) {
+    f32 radians[SINCOS_SWEEP_CHUNK];
+    f32 sines[SINCOS_SWEEP_CHUNK];
+    f32 cosines[SINCOS_SWEEP_CHUNK];
+    for (SimdLevel level = SimdLevel_Scalar; level <= SimdLevel_AVX2; level++) {
+        if (!enterSimdLevel(level)) {
+            continue;
+        }
+        char* name = simdLevelName(level);
+        f64 maxErrorExact = 0.0;
+        f64 maxErrorLibm = 0.0;
+        u32 mismatches = 0;
+        for (u32 first = 0; first < SINCOS_SWEEP_POINTS; first += SINCOS_SWEEP_CHUNK) {
+            for (u32 index = 0; index < SINCOS_SWEEP_CHUNK; index++) {
+                radians[index] = (f32)((f64)(first + index) * (f64)TAU32 / (f64)SINCOS_SWEEP_POINTS);
+            }
+            sincosBatch(sines, cosines, radians, SINCOS_SWEEP_CHUNK);
+            for (u32 index = 0; index < SINCOS_SWEEP_CHUNK; index++) {
+                f32 x = radians[index];
+                f32 sine;
+                f32 cosine;
+                sincosf32(x, &sine, &cosine);
+                mismatches += memcmp(&sine, sines + index, sizeof(f32)) != 0;
+                mismatches += memcmp(&cosine, cosines + index, sizeof(f32)) != 0;
+
+                f64 errorExact = fmax(fabs((f64)sines[index] - sin((f64)x)), fabs((f64)cosines[index] - cos((f64)x)));
+                f64 errorLibm = fmax(fabs((f64)sines[index] - (f64)sinf(x)), fabs((f64)cosines[index] - (f64)cosf(x)));
+                maxErrorExact = fmax(maxErrorExact, errorExact);
+                maxErrorLibm = fmax(maxErrorLibm, errorLibm);
+            }
+        }
+        printf("  %s: max error %.3g exact, %.3g libm\n", name, maxErrorExact, maxErrorLibm);
+        check(mismatches == 0, "%s: %u results differ from sincosf32", name, mismatches);
+        check(maxErrorExact <= SINCOS_MAX_ERROR_EXACT, "%s: error against exact %g", name, maxErrorExact);
+        check(maxErrorLibm <= SINCOS_MAX_ERROR_LIBM, "%s: error against libm %g", name, maxErrorLibm);
+    }
+    setSimdLevel(SimdLevel_AVX2);
+}
+
+//
+// NOTE(sen) Compaction bookkeeping the device heap runs on, without any device memory
+//
+
+typedef struct TestAllocation {
+    u32 blockIndex;
+    u64 offset;
+    u64 size;
+    b32 pinned;
+} TestAllocation;
+
+#define TEST_BLOCK_SIZE 1024
+#define TEST_ALIGNMENT 16
+
+void
+initTestBlock(MemoryBlock* block, u32 group, u64 size) {
+    memset(block, 0, sizeof(MemoryBlock));
+    block->live = true;
+    block->group = group;
+    initFreeList(&block->freeList, size);
+}
+
+// NOTE(sen) Same steps as fillDeviceAllocation, straight into the given block
+void
+allocTestBlock(MemoryBlock* blocks, u32 blockIndex, u64 size, b32 pinned, TestAllocation* allocation) {
+    allocation->blockIndex = blockIndex;
+    allocation->size = size;
+    allocation->pinned = pinned;
+    b32 found = allocFreeList(&blocks[blockIndex].freeList, size, TEST_ALIGNMENT, &allocation->offset);
+    assert(found);
+    if (pinned) {
+        blocks[blockIndex].pinnedCount++;
+    }
+}
+
+void
+testHeapCompaction(void) {
+    MemoryBlock blocks[6];
+    initTestBlock(blocks + 0, 0, TEST_BLOCK_SIZE);
+    initTestBlock(blocks + 1, 0, TEST_BLOCK_SIZE);
+    initTestBlock(blocks + 2, 0, TEST_BLOCK_SIZE);
+    initTestBlock(blocks + 3, 0, TEST_BLOCK_SIZE);
+    // NOTE(sen) Alone in its group, nowhere to move to
+    initTestBlock(blocks + 4, 1, TEST_BLOCK_SIZE);
+    // NOTE(sen) Made for one big allocation, never evacuated but takes contents
+    initTestBlock(blocks + 5, 0, TEST_BLOCK_SIZE * 4);
+
+    TestAllocation allocations[9];
+    allocTestBlock(blocks, 0, 256, false, allocations + 0);
+    allocTestBlock(blocks, 0, 256, false, allocations + 1);
+    allocTestBlock(blocks, 0, 256, false, allocations + 2);
+    allocTestBlock(blocks, 1, 64, false, allocations + 3);
+    allocTestBlock(blocks, 1, 64, false, allocations + 4);
+    allocTestBlock(blocks, 2, 128, true, allocations + 5);
+    allocTestBlock(blocks, 3, 64, false, allocations + 6);
+    allocTestBlock(blocks, 4, 64, false, allocations + 7);
+    allocTestBlock(blocks, 5, 64, false, allocations + 8);
+
+    u64 usedBefore[2] = { 0 };
+    for (u32 index = 0; index < arrayCount(blocks); index++) {
+        usedBefore[blocks[index].group] += blocks[index].freeList.used;
+    }
+
+    u32 marked = markMemoryBlocksForCompaction(blocks, arrayCount(blocks), TEST_BLOCK_SIZE);
+    check(marked == 2, "marked %u blocks, expected 2", marked);
+    check(!blocks[0].evacuating, "block 0 is over half full");
+    check(blocks[1].evacuating, "block 1 should be evacuated");
+    check(!blocks[2].evacuating, "block 2 holds a pinned allocation");
+    check(blocks[3].evacuating, "block 3 should be evacuated");
+    check(!blocks[4].evacuating, "block 4 has nowhere to go");
+    check(!blocks[5].evacuating, "block 5 is bigger than the usual block");
+
+    // NOTE(sen) Nothing new goes into blocks being emptied
+    for (u32 attempt = 0; attempt < 4; attempt++) {
+        u32 blockIndex = 0;
+        u64 offset = 0;
+        b32 found = allocMemoryBlocks(blocks, arrayCount(blocks), 0, 512, TEST_ALIGNMENT, &blockIndex, &offset);
+        check(found && !blocks[blockIndex].evacuating, "allocation went to evacuating block %u", blockIndex);
+        releaseFreeList(&blocks[blockIndex].freeList, offset, 512);
+    }
+
+    // NOTE(sen) Same steps as relocateBuffer then endHeapCompaction
+    TestAllocation retired[arrayCount(allocations)];
+    u32 retiredCount = 0;
+    for (u32 index = 0; index < arrayCount(allocations); index++) {
+        TestAllocation* allocation = allocations + index;
+        MemoryBlock* from = blocks + allocation->blockIndex;
+        if (!from->evacuating) {
+            continue;
+        }
+        check(!allocation->pinned, "pinned allocation %u in an evacuating block", index);
+        u32 blockIndex = 0;
+        u64 offset = 0;
+        b32 found = allocMemoryBlocks(blocks, arrayCount(blocks), from->group, allocation->size, TEST_ALIGNMENT, &blockIndex, &offset);
+        check(found, "no room to relocate allocation %u", index);
+        if (found) {
+            check(!blocks[blockIndex].evacuating && blocks[blockIndex].group == from->group, "allocation %u moved to block %u", index, blockIndex);
+            check(offset % TEST_ALIGNMENT == 0, "allocation %u moved to misaligned offset %llu", index, (unsigned long long)offset);
+            retired[retiredCount++] = *allocation;
+            allocation->blockIndex = blockIndex;
+            allocation->offset = offset;
+        }
+    }
+    check(retiredCount == 3, "relocated %u allocations, expected 3", retiredCount);
+    for (u32 index = 0; index < retiredCount; index++) {
+        releaseFreeList(&blocks[retired[index].blockIndex].freeList, retired[index].offset, retired[index].size);
+    }
+
+    u32 released = 0;
+    for (u32 index = 0; index < arrayCount(blocks); index++) {
+        if (endMemoryBlockEvacuation(blocks + index)) {
+            check(index == 1 || index == 3, "released block %u", index);
+            released++;
+            blocks[index].live = false;
+        }
+        check(!blocks[index].evacuating, "block %u still marked", index);
+    }
+    check(released == marked, "released %u of %u marked blocks", released, marked);
+
+    u64 usedAfter[2] = { 0 };
+    for (u32 index = 0; index < arrayCount(blocks); index++) {
+        if (blocks[index].live) {
+            usedAfter[blocks[index].group] += blocks[index].freeList.used;
+        }
+    }
+    check(usedAfter[0] == usedBefore[0] && usedAfter[1] == usedBefore[1], "used bytes changed by compaction");
+
+    // NOTE(sen) Live allocations never overlap
+    for (u32 first = 0; first < arrayCount(allocations); first++) {
+        for (u32 second = first + 1; second < arrayCount(allocations); second++) {
+            TestAllocation* a = allocations + first;
+            TestAllocation* b = allocations + second;
+            b32 overlap = a->blockIndex == b->blockIndex
+                && a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+            check(!overlap, "allocations %u and %u overlap", first, second);
+        }
+    }
+
+    check(markMemoryBlocksForCompaction(blocks, arrayCount(blocks), TEST_BLOCK_SIZE) == 0, "second pass found more to do");
+
+    for (u32 index = 0; index < arrayCount(blocks); index++) {
+        destroyFreeList(&blocks[index].freeList);
+    }
+}
+
+//
+// NOTE(sen) Host allocator behind the driver callbacks, worth running under ASan
+//
+
+#define TEST_HOST_ARENA_SIZE 4096
+
+void
+testHostAllocator(void) {
+    HostAllocator allocator;
+    memset(&allocator, 0, sizeof(HostAllocator));
+    initHostArenas(&allocator, TEST_HOST_ARENA_SIZE);
+
+    // NOTE(sen) Alignment is of the returned address, well past what malloc gives the arena base
+    for (u32 objectLifetime = 0; objectLifetime < 2; objectLifetime++) {
+        for (usize alignment = 1; alignment <= 256; alignment *= 2) {
+            void* pointers[5];
+            for (u32 index = 0; index < arrayCount(pointers); index++) {
+                usize size = 24 + index * 7;
+                u8* memory = allocHost(&allocator, size, alignment, objectLifetime);
+                pointers[index] = memory;
+                check(memory != 0, "allocation of %zu failed", size);
+                check((usize)memory % alignment == 0, "%p not aligned to %zu (arena %u)", memory, alignment, objectLifetime);
+                memset(memory, 0xAB, size);
+            }
+            for (u32 index = 0; index < arrayCount(pointers); index++) {
+                freeHost(&allocator, pointers[index]);
+            }
+        }
+    }
+    check(allocator.stats.arenaAllocations == 45, "%llu arena allocations, expected 45", (unsigned long long)allocator.stats.arenaAllocations);
+    check(allocator.arenas[0].used == 0 && allocator.arenas[0].live == 0, "arena did not rewind");
+
+    // NOTE(sen) Contents survive a move, in and out of the arena
+    u8* grown = allocHost(&allocator, 16, 64, true);
+    for (u32 index = 0; index < 16; index++) {
+        grown[index] = (u8)index;
+    }
+    grown = reallocHost(&allocator, grown, 1024, 64, false);
+    check((usize)grown % 64 == 0, "realloc lost alignment");
+    b32 kept = true;
+    for (u32 index = 0; index < 16; index++) {
+        kept = kept && grown[index] == index;
+    }
+    check(kept, "realloc lost contents");
+    grown = reallocHost(&allocator, grown, 8, 128, true);
+    check((usize)grown % 128 == 0 && grown[7] == 7, "shrinking realloc");
+    check(reallocHost(&allocator, grown, 0, 128, true) == 0, "realloc to 0 frees");
+
+    // NOTE(sen) A full arena falls back to malloc, a flip goes to the other arena
+    u64 arenaBefore = allocator.stats.arenaAllocations;
+    void* big = allocHost(&allocator, TEST_HOST_ARENA_SIZE - 256, 16, true);
+    void* spill = allocHost(&allocator, 512, 16, true);
+    check(allocator.stats.arenaAllocations == arenaBefore + 1, "spill should not come from the arena");
+    check(findHostArena(&allocator, spill) == 0, "spill is in an arena");
+    flipHostArena(&allocator);
+    void* flipped = allocHost(&allocator, 512, 16, true);
+    check(findHostArena(&allocator, flipped) == allocator.arenas + 1, "allocation after flip not in the second arena");
+    freeHost(&allocator, big);
+    freeHost(&allocator, spill);
+    freeHost(&allocator, flipped);
+
+    check(allocator.stats.live == 0 && allocator.stats.bytes == 0, "%u allocations, %zu bytes still live", allocator.stats.live, allocator.stats.bytes);
+    check(allocator.stats.frees == allocator.stats.allocations, "allocations and frees differ");
+    destroyHostArenas(&allocator);
+}
+
+//
+// NOTE(sen) Retained rect store: slot reuse, per-image dirty lists and the runs a flush reports
+//
+
+#define TEST_STORE_CAPACITY 16
+
+Rect
+makeTestRect(f32 x) {
+    Rect result = { 0 };
+    result.topleft = v3new(x, 0.0f, 0.0f);
+    result.bottomright = v3new(x + 0.5f, 0.5f, 0.0f);
+    result.texbottomright.x = 1.0f;
+    result.texbottomright.y = 1.0f;
+    return result;
+}
+
+// NOTE(sen) The slot's vertices are what pushRects writes for its rect
+b32
+storeSlotMatches(GeometryBuffer* buffer, u32 slot, Rect rect) {
+    Vertex expected[4];
+    GeometryBuffer reference = *buffer;
+    reference.vertexData = expected;
+    reference.curVertex = 0;
+    reference.curIndex = 0;
+    pushRects(&reference, &rect, 1, m4identity());
+    return memcmp(buffer->vertexData + slot * 4, expected, sizeof(expected)) == 0;
+}
+
+b32
+runsEqual(RectRun* runs, u32 runCount, RectRun* expected, u32 expectedCount) {
+    b32 result = runCount == expectedCount;
+    for (u32 index = 0; index < runCount && result; index++) {
+        result = runs[index].first == expected[index].first && runs[index].count == expected[index].count;
+    }
+    return result;
+}
+
+void
+testRectStore(void) {
+    RectStore store;
+    initRectStore(&store, TEST_STORE_CAPACITY, 2);
+
+    GeometryBuffer buffer;
+    memset(&buffer, 0, sizeof(GeometryBuffer));
+    buffer.format = VertexFormat_F32;
+    buffer.vertexCapacity = TEST_STORE_CAPACITY * 4;
+    buffer.indexCapacity = TEST_STORE_CAPACITY * 6;
+    buffer.vertexData = calloc(buffer.vertexCapacity, sizeof(Vertex));
+
+    RectRun runs[TEST_STORE_CAPACITY];
+    u32 runCount = 0;
+
+    for (u32 index = 0; index < 5; index++) {
+        u32 slot = addStoreRect(&store, makeTestRect((f32)index));
+        check(slot == index, "add %u got slot %u", index, slot);
+    }
+    u32 written = flushRectStore(&store, 0, &buffer, runs, &runCount);
+    RectRun all[] = { { 0, 5 } };
+    check(written == 5 && runsEqual(runs, runCount, all, arrayCount(all)), "first flush: %u rects in %u runs", written, runCount);
+    check(buffer.curVertex == 20 && buffer.curIndex == 30, "cursors don't cover the slots");
+    check(storeSlotMatches(&buffer, 3, makeTestRect(3.0f)), "slot 3 vertices");
+    check(flushRectStore(&store, 0, &buffer, runs, &runCount) == 0 && runCount == 0, "second flush rewrote something");
+
+    // NOTE(sen) A removed slot is reused and is only queued once per image
+    removeStoreRect(&store, 2);
+    check(!store.live[2], "removed slot still live");
+    u32 reused = addStoreRect(&store, makeTestRect(20.0f));
+    check(reused == 2 && store.live[2], "removed slot not reused, got %u", reused);
+    u32 fresh = addStoreRect(&store, makeTestRect(5.0f));
+    check(fresh == 5, "new slot %u after reuse", fresh);
+    setStoreRect(&store, 4, makeTestRect(40.0f));
+
+    written = flushRectStore(&store, 0, &buffer, runs, &runCount);
+    RectRun changed[] = { { 2, 1 }, { 5, 1 }, { 4, 1 } };
+    check(written == 3 && runsEqual(runs, runCount, changed, arrayCount(changed)), "flush after changes: %u rects in %u runs", written, runCount);
+    check(storeSlotMatches(&buffer, 2, makeTestRect(20.0f)), "reused slot vertices");
+    check(storeSlotMatches(&buffer, 4, makeTestRect(40.0f)), "set slot vertices");
+
+    // NOTE(sen) Image 1 was never flushed, each slot is in its list once
+    written = flushRectStore(&store, 1, &buffer, runs, &runCount);
+    RectRun image1[] = { { 0, 6 } };
+    check(written == 6 && runsEqual(runs, runCount, image1, arrayCount(image1)), "image 1 flush: %u rects in %u runs", written, runCount);
+
+    // NOTE(sen) A removal leaves a degenerate quad behind
+    removeStoreRect(&store, 1);
+    Rect degenerate = { 0 };
+    flushRectStore(&store, 0, &buffer, runs, &runCount);
+    check(storeSlotMatches(&buffer, 1, degenerate), "removed slot not degenerate");
+
+    // NOTE(sen) Changing the image count dirties every slot for every image
+    setRectStoreImageCount(&store, 3);
+    for (u32 imageIndex = 0; imageIndex < 3; imageIndex++) {
+        check(store.dirtyCounts[imageIndex] == 6, "image %u has %u dirty slots after resize", imageIndex, store.dirtyCounts[imageIndex]);
+    }
+    written = flushRectStore(&store, 2, &buffer, runs, &runCount);
+    check(written == 6 && runsEqual(runs, runCount, image1, arrayCount(image1)), "resized image 2 flush: %u rects in %u runs", written, runCount);
+    check(store.dirtyCounts[0] == 6 && store.dirtyCounts[1] == 6, "flushing one image touched another");
+    for (u32 slot = 0; slot < store.slotCount; slot++) {
+        check((store.dirtyImages[slot] & 4) == 0 && (store.dirtyImages[slot] & 3) == 3, "slot %u dirty bits %x", slot, store.dirtyImages[slot]);
+    }
+
+    // NOTE(sen) Free slots come back before new ones, until the store is full
+    u32 again = addStoreRect(&store, makeTestRect(10.0f));
+    check(again == 1, "freed slot 1 not reused, got %u", again);
+    while (store.slotCount < TEST_STORE_CAPACITY) {
+        addStoreRect(&store, makeTestRect(0.0f));
+    }
+    check(store.freeCount == 0, "%u free slots in a full store", store.freeCount);
+
+    free(buffer.vertexData);
+    destroyRectStore(&store);
+}
+
+static Test globalTests[] = {
+    { "m4Kernels", testM4Kernels },
+    { "f32ToHalf", testF32ToHalf },
+    { "sincosSweep", testSincosSweep },
+    { "heapCompaction", testHeapCompaction },
+    { "hostAllocator", testHostAllocator },
+    { "rectStore", testRectStore },
+};
+
+int
+main(int argc, char** argv) {
+    char* filter = 0;
+    for (i32 argIndex = 1; argIndex + 1 < argc; argIndex += 2) {
+        if (strcmp(argv[argIndex], "-filter") == 0) {
+            filter = argv[argIndex + 1];
+        } else {
+            fprintf(stderr, "unknown argument %s\n", argv[argIndex]);
+            return 1;
+        }
+    }
+
+    for (u32 index = 0; index < arrayCount(globalTests); index++) {
+        Test* test = globalTests + index;
+        if (filter && !strstr(test->name, filter)) {
+            continue;
+        }
+        u32 failuresBefore = globalFailures;
+        printf("%s\n", test->name);
+        test->fn();
+        if (globalFailures > failuresBefore) {
+            printf("  FAILED (%u)\n", globalFailures - failuresBefore);
+        }
+    }
+    printf("%u checks, %u failed\n", globalChecks, globalFailures);
+    return globalFailures == 0 ? 0 : 1;
+}
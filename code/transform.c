@@ -0,0 +1,134 @@
+// NOTE(sen) Translation/rotation/scale with the composed matrices cached.
+// Change the inputs through the setters so the cache knows to rebuild.
+typedef struct Transform {
+    v3 translation;
+    quat rotation;
+    v3 scale;
+    struct Transform* parent;
+    m4 local;
+    m4 world;
+    b32 localDirty;
+    // NOTE(sen) Bumped whenever world changes, children compare against it
+    u32 worldVersion;
+    u32 parentWorldVersion;
+} Transform;
+
+typedef struct Camera {
+    v3 eye;
+    v3 target;
+    v3 up;
+    f32 fovYRadians;
+    f32 nearPlane;
+    f32 farPlane;
+    m4 view;
+    m4 proj;
+    b32 viewDirty;
+    // NOTE(sen) Projection only depends on these (and the fields above it)
+    v2 projSurfaceDim;
+    b32 projDirty;
+} Camera;
+
+void
+initTransform(Transform* transform) {
+    memset(transform, 0, sizeof(Transform));
+    transform->rotation = quatIdentity();
+    transform->scale = v3new(1.0f, 1.0f, 1.0f);
+    transform->localDirty = true;
+}
+
+void
+setTransformTranslation(Transform* transform, v3 translation) {
+    transform->translation = translation;
+    transform->localDirty = true;
+}
+
+void
+setTransformRotation(Transform* transform, quat rotation) {
+    transform->rotation = rotation;
+    transform->localDirty = true;
+}
+
+void
+setTransformScale(Transform* transform, v3 scale) {
+    transform->scale = scale;
+    transform->localDirty = true;
+}
+
+void
+setTransformParent(Transform* transform, Transform* parent) {
+    transform->parent = parent;
+    transform->localDirty = true;
+}
+
+m4
+getTransformLocal(Transform* transform) {
+    if (transform->localDirty) {
+        transform->local = m4fromTRS(transform->translation, transform->rotation, transform->scale);
+    }
+    return transform->local;
+}
+
+// NOTE(sen) Only multiplies when this transform or one of its parents changed
+m4
+getTransformWorld(Transform* transform) {
+    b32 localChanged = transform->localDirty;
+    m4 local = getTransformLocal(transform);
+    transform->localDirty = false;
+
+    if (transform->parent) {
+        m4 parentWorld = getTransformWorld(transform->parent);
+        if (localChanged || transform->parentWorldVersion != transform->parent->worldVersion) {
+            transform->world = m4mul(local, parentWorld);
+            transform->parentWorldVersion = transform->parent->worldVersion;
+            transform->worldVersion++;
+        }
+    } else if (localChanged) {
+        transform->world = local;
+        transform->worldVersion++;
+    }
+
+    return transform->world;
+}
+
+void
+initCamera(Camera* camera, v3 eye, v3 target, v3 up, f32 fovYRadians, f32 nearPlane, f32 farPlane) {
+    memset(camera, 0, sizeof(Camera));
+    camera->eye = eye;
+    camera->target = target;
+    camera->up = up;
+    camera->fovYRadians = fovYRadians;
+    camera->nearPlane = nearPlane;
+    camera->farPlane = farPlane;
+    camera->viewDirty = true;
+    camera->projDirty = true;
+}
+
+void
+setCameraLookat(Camera* camera, v3 eye, v3 target, v3 up) {
+    camera->eye = eye;
+    camera->target = target;
+    camera->up = up;
+    camera->viewDirty = true;
+}
+
+m4
+getCameraView(Camera* camera) {
+    if (camera->viewDirty) {
+        camera->view = m4lookat(camera->eye, camera->target, camera->up);
+        camera->viewDirty = false;
+    }
+    return camera->view;
+}
+
+// NOTE(sen) Rebuilt only when the surface is resized
+m4
+getCameraProjection(Camera* camera, v2 surfaceDim) {
+    if (camera->projDirty || camera->projSurfaceDim.x != surfaceDim.x || camera->projSurfaceDim.y != surfaceDim.y) {
+        camera->proj = m4perspective(
+            camera->fovYRadians, surfaceDim.x / surfaceDim.y, camera->nearPlane, camera->farPlane
+        );
+        camera->projSurfaceDim = surfaceDim;
+        camera->projDirty = false;
+    }
+    return camera->proj;
+}
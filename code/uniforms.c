@@ -0,0 +1,37 @@
+// NOTE(sen) What the shaders read besides vertices: the per-frame uniform block and the
+// per-draw push constants. Layouts match shader.vert and quad.vert.
+
+// NOTE(sen) Per frame, bound with a dynamic offset
+typedef struct UniformBufferObject {
+    m4 model;
+    m4 view;
+    m4 proj;
+} UniformBufferObject;
+
+// NOTE(sen) Per draw, recorded with vkCmdPushConstants so a draw with its own transform needs
+// no uniform write or descriptor bind. 80 of the 128 bytes every device has. model applies
+// before the per-frame model, tint multiplies the texture.
+typedef struct DrawConstants {
+    m4 model;
+    f32 tint[4];
+} DrawConstants;
+
+// NOTE(sen) Maps the unit quad (0, 0)-(1, 1) at z 0 onto the rect
+m4
+getUnitQuadModel(Rect rect) {
+    m4 result = m4scale(rect.bottomright.x - rect.topleft.x, rect.bottomright.y - rect.topleft.y, 1.0f);
+    result.m12 = rect.topleft.x;
+    result.m13 = rect.topleft.y;
+    result.m14 = rect.topleft.z;
+    return result;
+}
+
+DrawConstants
+getDefaultDrawConstants() {
+    DrawConstants result = { 0 };
+    result.model = m4identity();
+    for (u32 index = 0; index < 4; index++) {
+        result.tint[index] = 1.0f;
+    }
+    return result;
+}